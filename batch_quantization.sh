@@ -0,0 +1,45 @@
+#!/bin/bash
+
+if [ "$#" -ne 5 ]; then
+  echo "usage $0 mapFile randomFile nbOfAnts nbOfInternalLoops nbOfExternalLoops"
+  exit 1
+fi
+
+mapFile=$1
+randomFile=$2
+
+ROOT="ant_colony"
+NB_ANTS=$3
+NB_INTERNAL_LOOP=$4
+NB_EXTERNAL_LOOP=$5
+ALPHA=1
+BETA=1
+EVAPORATION=0.9
+
+## Quantized parallel3 jobs (full precision jobs are launched by batch.sh)
+## The outputs are named quantized-format-jobId.out to not be mixed with the
+## slurm files of batch.sh
+cd parallel3
+for q in "bf16" "fp16" "log8" "log16"
+do
+  for i in 1 2 4 8 16
+  do
+    FILE="mpi_${ROOT}_$q$i.run"
+    if [ -e $FILE ]; then
+      rm $FILE
+    fi
+    touch $FILE
+    echo "#!/bin/bash" >> $FILE
+    echo "#SBATCH --nodes $i" >> $FILE
+    echo "#SBATCH --ntasks-per-node 1" >> $FILE
+    echo "#SBATCH --cpus-per-task 1" >> $FILE
+    echo "#SBATCH --mem 4096" >> $FILE
+    echo "#SBATCH --time 04:00:00" >> $FILE
+    echo "#SBATCH --output quantized-$q-%j.out" >> $FILE
+    echo "module purge" >> $FILE
+    echo "module load intel intelmpi" >> $FILE
+    echo "srun ./mpi_ant_colony_$q ../$mapFile ../$randomFile $NB_ANTS $NB_EXTERNAL_LOOP $NB_INTERNAL_LOOP $ALPHA $BETA $EVAPORATION" >> $FILE
+    sbatch $FILE
+  done
+done
+cd ..
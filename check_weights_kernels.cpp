@@ -0,0 +1,106 @@
+/**
+ *
+ * Ant Colony Traveling Salesman Problem Optimization
+ * check_weights_kernels.cpp - check the SIMD weights kernels against the
+ * scalar reference kernel
+ *
+ **/
+
+#include "serial/utils.h"
+
+#define CHECK_ROW_SIZE 1000
+#define CHECK_TRIALS 100
+
+/**
+ * Fill cities with n distinct random cities of a row of rowSize cities
+ **/
+void randomCities(int* cities, int n, int* order, int rowSize) {
+  int i;
+  for (i = 0; i < rowSize; i++) {
+    order[i] = i;
+  }
+  for (i = 0; i < n; i++) {
+    int j = i + rand() % (rowSize - i);
+    std::swap(order[i], order[j]);
+    cities[i] = order[i];
+  }
+}
+
+/**
+ * Compare a kernel with the scalar one on random rows and lists of cities of
+ * the given lengths. The weights and the total have to be exactly the same,
+ * and nothing has to be written after the weights.
+ * Returns the number of differences
+ **/
+int checkKernel(const char* name, WeightsKernel kernel, int* lengths, int nLengths) {
+  int l, t, i;
+  int nErrors = 0;
+  double* row = (double*) malloc(CHECK_ROW_SIZE*sizeof(double));
+  double* weights = (double*) malloc((CHECK_ROW_SIZE + 1)*sizeof(double));
+  double* reference = (double*) malloc((CHECK_ROW_SIZE + 1)*sizeof(double));
+  int* cities = (int*) malloc(CHECK_ROW_SIZE*sizeof(int));
+  int* order = (int*) malloc(CHECK_ROW_SIZE*sizeof(int));
+
+  for (l = 0; l < nLengths; l++) {
+    int n = lengths[l];
+    for (t = 0; t < CHECK_TRIALS; t++) {
+      // weights of very different magnitudes, some of them 0
+      for (i = 0; i < CHECK_ROW_SIZE; i++) {
+        row[i] = (rand() % 10 == 0) ? 0.0 : ldexp((double) rand() / RAND_MAX, -(rand() % 60));
+      }
+      randomCities(cities, n, order, CHECK_ROW_SIZE);
+      std::fill(weights, weights + CHECK_ROW_SIZE + 1, -1.0);
+      std::fill(reference, reference + CHECK_ROW_SIZE + 1, -1.0);
+      double total = kernel(weights, row, cities, n);
+      double referenceTotal = computeWeightsScalar(reference, row, cities, n);
+      if (total != referenceTotal || memcmp(weights, reference, (n + 1)*sizeof(double)) != 0) {
+        nErrors++;
+      }
+    }
+    if (nErrors > 0) {
+      printf("%s : differs from the scalar kernel for %d cities\n", name, n);
+      break;
+    }
+  }
+  if (nErrors == 0) {
+    printf("%s : OK\n", name);
+  }
+
+  free(row);
+  free(weights);
+  free(reference);
+  free(cities);
+  free(order);
+  return nErrors;
+}
+
+int main(int argc, char* argv[]) {
+  int lengths[] = {0, 1, 3, 7, 8, 9, 15, 16, 17, CHECK_ROW_SIZE - 1, CHECK_ROW_SIZE};
+  int nLengths = sizeof(lengths) / sizeof(int);
+  int nErrors = 0;
+
+  srand(0);
+  nErrors += checkKernel("Scalar", computeWeightsScalar, lengths, nLengths);
+#ifdef SIMD_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    nErrors += checkKernel("SSE2", computeWeightsSSE2, lengths, nLengths);
+  } else {
+    printf("SSE2 : not supported by the CPU\n");
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    nErrors += checkKernel("AVX2", computeWeightsAVX2, lengths, nLengths);
+  } else {
+    printf("AVX2 : not supported by the CPU\n");
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    nErrors += checkKernel("AVX-512", computeWeightsAVX512, lengths, nLengths);
+  } else {
+    printf("AVX-512 : not supported by the CPU\n");
+  }
+#else
+  printf("No SIMD kernels in this build\n");
+#endif
+
+  return nErrors > 0 ? -1 : 0;
+}
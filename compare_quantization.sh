@@ -0,0 +1,69 @@
+#!/bin/zsh
+
+# Compare the best costs of the quantized pheromons exchange of parallel3
+# (launched by batch_quantization.sh) with the full precision one (launched by
+# batch.sh), for the same random files and numbers of nodes
+
+for q in "bf16" "fp16" "log8" "log16"
+do
+  OUTPUT="comparison_$q.txt"
+  FULL_Q=()
+  Q_FULL=()
+
+  for random in $(ls . | grep random | grep .txt)
+  do
+    FILE="../$random"
+    FULLCOST=()
+    QUANTIZEDCOST=()
+
+    cd parallel3
+
+    # Full precision files
+    for results in $(ls | grep slurm)
+    do
+      temp=$(cat $results | grep $FILE)
+      if [ "$temp" != "" ]; then
+        N=$(head -n 1 $results | wc -w)
+        INDEX=$(head -n 1 $results | awk -v N=$N '{print $N}')
+        N=$(head -n 6 $results | tail -n 1 | wc -w)
+        FULLCOST[$INDEX]=$(head -n 6 $results | tail -n 1 | awk -v N=$N '{print $N}')
+      fi
+    done
+
+    # Quantized files
+    for results in $(ls | grep "quantized-$q-")
+    do
+      temp=$(cat $results | grep $FILE)
+      if [ "$temp" != "" ]; then
+        N=$(head -n 1 $results | wc -w)
+        INDEX=$(head -n 1 $results | awk -v N=$N '{print $N}')
+        if [ "$FULL_Q[$INDEX]" = "" ]; then
+          FULL_Q[$INDEX]=0
+        fi
+        if [ "$Q_FULL[$INDEX]" = "" ]; then
+          Q_FULL[$INDEX]=0
+        fi
+        N=$(head -n 6 $results | tail -n 1 | wc -w)
+        QUANTIZEDCOST[$INDEX]=$(head -n 6 $results | tail -n 1 | awk -v N=$N '{print $N}')
+        if [ "$FULLCOST[$INDEX]" = "" ]; then
+          continue
+        fi
+        if [ "$QUANTIZEDCOST[$INDEX]" -gt "$FULLCOST[$INDEX]" ]; then
+          FULL_Q[$INDEX]=$(echo "$FULL_Q[$INDEX] + 1" | bc)
+        elif [ "$QUANTIZEDCOST[$INDEX]" -lt "$FULLCOST[$INDEX]" ]; then
+          Q_FULL[$INDEX]=$(echo "$Q_FULL[$INDEX] + 1" | bc)
+        fi
+      fi
+    done
+
+    cd ..
+
+    echo "$FULLCOST $QUANTIZEDCOST" >> $OUTPUT
+  done
+
+  echo "$OUTPUT" >> $OUTPUT
+  echo "Summary" >> $OUTPUT
+  echo "Full precision beats Quantized : $FULL_Q" >> $OUTPUT
+  echo "Quantized beats Full precision : $Q_FULL" >> $OUTPUT
+  echo "" >> $OUTPUT
+done
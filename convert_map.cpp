@@ -0,0 +1,58 @@
+/**
+ *
+ * Ant Colony Traveling Salesman Problem Optimization - MPI
+ * Convert Map
+ * Convert a map (generate_map or TSPLIB format) to a binary map file, or a
+ * random numbers file to a binary random numbers file (-r), which are loaded
+ * without parsing by the solvers
+ *
+ **/
+
+#include "serial/utils.h"
+
+
+int main(int argc, char* argv[]) {
+
+  if (argc != 3 && (argc != 4 || strcmp(argv[1], "-r") != 0)) {
+    printf("use : %s mapFile binaryFile\n", argv[0]);
+    printf("      %s -r randomFile binaryFile\n", argv[0]);
+    return -1;
+  }
+
+  if (argc == 4) {
+    long* randomNumbers = NULL;
+    long nRandomNumbers = 0;
+    if (LoadRandomNumbers(argv[2], &randomNumbers, &nRandomNumbers)) {
+      printf("The filepath %s is incorrect\n", argv[2]);
+      return -1;
+    }
+    if (SaveBinaryRandomNumbers(argv[3], randomNumbers, nRandomNumbers)) {
+      printf("The binary random numbers file %s cannot be written\n", argv[3]);
+      free(randomNumbers);
+      return -1;
+    }
+    printf("RandomNumbers %ld\n", nRandomNumbers);
+    free(randomNumbers);
+    return 0;
+  }
+
+  DistanceMatrix map;
+  int nCities = 0;
+
+  if (LoadMap(argv[1], &map, &nCities)) {
+    printf("The filepath %s is incorrect\n", argv[1]);
+    return -1;
+  }
+
+  if (SaveBinaryMap(argv[2], &map, nCities)) {
+    printf("The binary map %s cannot be written\n", argv[2]);
+    freeDistances(&map);
+    return -1;
+  }
+
+  printf("Cities %d\n", nCities);
+
+  freeDistances(&map);
+
+  return 0;
+}
@@ -16,8 +16,8 @@
 
 int main(int argc, char* argv[]) {
 
-  if (argc != 4) {
-    printf("use : %s filename size maximalDistance\n", argv[0]);
+  if (argc != 4 && (argc != 5 || strcmp(argv[4], "coordinates") != 0)) {
+    printf("use : %s filename size maximalDistance [coordinates]\n", argv[0]);
     return -1;
   }
 
@@ -27,6 +27,18 @@ int main(int argc, char* argv[]) {
   int**map;
   int i, j;
 
+  // Euclidean map : cities placed at random in a maximalDistance square
+  if (argc == 5) {
+    outfile << size << " EUC_2D" << std::endl;
+    for (i = 0; i < size; i++) {
+      int x = rand() % (maxDistance + 1);
+      int y = rand() % (maxDistance + 1);
+      outfile << x << " " << y << std::endl;
+    }
+    outfile.close();
+    return 0;
+  }
+
   // Allocation of map
   map = (int**) malloc(size*sizeof(int*));
   for (i = 0; i < size; i++) {
@@ -1,7 +1,7 @@
 #!/bin/bash
 
-if [ "$#" -ne 7 ]; then
-  echo "usage $0 mapFileName sizeOfMap maxDistance nbOfRandomFiles nbOfAnts InternalLoops ExternalLoops"
+if [ "$#" -ne 7 ] && [ "$#" -ne 8 ]; then
+  echo "usage $0 mapFileName sizeOfMap maxDistance nbOfRandomFiles nbOfAnts InternalLoops ExternalLoops [quantized]"
   exit 1
 fi
 
@@ -12,6 +12,7 @@ loops=$4
 nAnts=$5
 internal=$6
 external=$7
+quantized=$8
 
 # Compile codes
 
@@ -27,6 +28,9 @@ cd ..
 cd parallel3
 make clean
 make
+if [ "$quantized" = "quantized" ]; then
+  make quantized
+fi
 cd ..
 cd serial
 make clean
@@ -43,6 +47,9 @@ do
   RAND="random$i.txt"
   ./generate_random_numbers $RAND 100000
   ./batch.sh $mapFileName $RAND $nAnts $internal $external
+  if [ "$quantized" = "quantized" ]; then
+    ./batch_quantization.sh $mapFileName $RAND $nAnts $internal $external
+  fi
   sleep 1
 done
 
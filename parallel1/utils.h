@@ -6,26 +6,482 @@
  *
  **/
 
+#ifndef UTILS_H
+#define UTILS_H
+
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <float.h>
+#include <limits.h>
+#include <stdint.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <limits>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define INFTY 999999999
 
+// Random numbers are in [0, RANDOM_RANGE[ (see generate_random_numbers.cpp)
+#define RANDOM_RANGE INT_MAX
+
+// Rows with more weights than this use a binary search over prefix sums for
+// the roulette wheel selection (linear scan otherwise).
+#ifndef ROULETTE_LINEAR_MAX
+#define ROULETTE_LINEAR_MAX 128
+#endif
+
+// Number of nearest neighbours used as candidates when choosing the next city.
+// 0 means that all the cities are candidates (no candidate lists).
+#ifndef NN_LIST_SIZE
+#define NN_LIST_SIZE 0
+#endif
+
+// With COUNTER_RNG, the random numbers are generated by a counter-based
+// generator (see AntRandom) instead of being read from the random file, whose
+// argument is then the seed of the generator.
+
+// The pheromons matrix is renormalized when its scale falls below this value
+#define PHEROMON_SCALE_MIN 1e-100
+
 double start, end;
 
+/**
+ * Scratch buffers used by the kernels for one ant. They are allocated once
+ * at startup so that the iterations do not allocate any memory.
+ **/
+struct AntWorkspace {
+  // weights of the next cities (or candidates) of the current step
+  double* weights;
+  // prefix sums of the weights for the roulette wheel selection
+  double* cumulative;
+  // cities not visited yet by the path in construction (nUnvisited first values)
+  int* unvisited;
+  int nUnvisited;
+  // position of each city in unvisited (-1 if the city is visited)
+  int* unvisitedIndex;
+  // path in construction and best path (with its cost and ant) of the
+  // ants built with this workspace during an iteration
+  int* path;
+  int* bestPath;
+  long bestCost;
+  int bestAnt;
+  // deque of the ants [nextAnt, endAnt) of an iteration left to this thread :
+  // the thread takes them from the front, the other threads steal from the back
+  int nextAnt;
+  int endAnt;
+#ifdef _OPENMP
+  omp_lock_t antsLock;
+#endif
+  // time spent building ants and waiting for the other threads at the end of
+  // the iterations, and number of steals (summed over the iterations)
+  double finishTime;
+  double busyTime;
+  double waitTime;
+  long nSteals;
+};
+
+void allocateWorkspace(AntWorkspace* workspace, int nCities) {
+  workspace->weights = (double*) malloc(nCities*sizeof(double));
+  workspace->cumulative = (double*) malloc(nCities*sizeof(double));
+  workspace->unvisited = (int*) malloc(nCities*sizeof(int));
+  workspace->unvisitedIndex = (int*) malloc(nCities*sizeof(int));
+  workspace->nUnvisited = 0;
+  workspace->path = (int*) malloc(nCities*sizeof(int));
+  workspace->bestPath = (int*) malloc(nCities*sizeof(int));
+  workspace->bestCost = INFTY;
+  workspace->bestAnt = -1;
+  workspace->nextAnt = 0;
+  workspace->endAnt = 0;
+#ifdef _OPENMP
+  omp_init_lock(&workspace->antsLock);
+#endif
+  workspace->finishTime = 0.0;
+  workspace->busyTime = 0.0;
+  workspace->waitTime = 0.0;
+  workspace->nSteals = 0;
+}
+
+void freeWorkspace(AntWorkspace* workspace) {
+  free(workspace->weights);
+  free(workspace->cumulative);
+  free(workspace->unvisited);
+  free(workspace->unvisitedIndex);
+  free(workspace->path);
+  free(workspace->bestPath);
+#ifdef _OPENMP
+  omp_destroy_lock(&workspace->antsLock);
+#endif
+}
+
+/**
+ * Number of threads building the ants (OpenMP), 1 without OpenMP
+ **/
+int getNumberOfThreads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+int getThreadNumber() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Allocate one workspace per thread (see getNumberOfThreads)
+ **/
+AntWorkspace* allocateWorkspaces(int nCities) {
+  int t;
+  AntWorkspace* workspaces = (AntWorkspace*) malloc(getNumberOfThreads()*sizeof(AntWorkspace));
+  for (t = 0; t < getNumberOfThreads(); t++) {
+    allocateWorkspace(&workspaces[t], nCities);
+  }
+  return workspaces;
+}
+
+void freeWorkspaces(AntWorkspace* workspaces) {
+  int t;
+  for (t = 0; t < getNumberOfThreads(); t++) {
+    freeWorkspace(&workspaces[t]);
+  }
+  free(workspaces);
+}
+
+void lockAnts(AntWorkspace* workspace) {
+#ifdef _OPENMP
+  omp_set_lock(&workspace->antsLock);
+#endif
+}
+
+void unlockAnts(AntWorkspace* workspace) {
+#ifdef _OPENMP
+  omp_unset_lock(&workspace->antsLock);
+#endif
+}
+
+/**
+ * Take the next ant to build by the thread : the first ant of its deque, or
+ * if it is empty, the last half of the deque of another thread (the first
+ * ant stolen is returned and the others are put in the deque of the thread).
+ * Returns -1 when all the deques are empty.
+ **/
+int takeAnt(AntWorkspace* workspaces, int nThreads, int thread) {
+  AntWorkspace* workspace = &workspaces[thread];
+  int ant = -1;
+  int i;
+
+  lockAnts(workspace);
+  if (workspace->nextAnt < workspace->endAnt) {
+    ant = workspace->nextAnt++;
+  }
+  unlockAnts(workspace);
+  if (ant != -1) {
+    return ant;
+  }
+
+  for (i = 1; i < nThreads; i++) {
+    AntWorkspace* victim = &workspaces[(thread + i) % nThreads];
+    int first = 0, end = 0;
+    lockAnts(victim);
+    if (victim->nextAnt < victim->endAnt) {
+      end = victim->endAnt;
+      first = end - (victim->endAnt - victim->nextAnt + 1) / 2;
+      victim->endAnt = first;
+    }
+    unlockAnts(victim);
+    if (first < end) {
+      lockAnts(workspace);
+      workspace->nextAnt = first + 1;
+      workspace->endAnt = end;
+      workspace->nSteals++;
+      unlockAnts(workspace);
+      return first;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Mark all the cities as not visited
+ **/
+void resetUnvisited(AntWorkspace* workspace, int nCities) {
+  int i;
+  for (i = 0; i < nCities; i++) {
+    workspace->unvisited[i] = i;
+    workspace->unvisitedIndex[i] = i;
+  }
+  workspace->nUnvisited = nCities;
+}
+
+/**
+ * Mark a city as visited : it is replaced in the unvisited cities by the
+ * last unvisited one (swap-remove)
+ **/
+void removeUnvisited(AntWorkspace* workspace, int city) {
+  int index = workspace->unvisitedIndex[city];
+  int last = workspace->unvisited[workspace->nUnvisited - 1];
+  workspace->unvisited[index] = last;
+  workspace->unvisitedIndex[last] = index;
+  workspace->unvisitedIndex[city] = -1;
+  workspace->nUnvisited--;
+}
+
 int getMatrixIndex(int i, int j, int matrixSize) {
   return (i * matrixSize) + j;
 }
 
+/**
+ * The map, heuristic, pheromons and choice information matrices are symmetric.
+ * With SYMMETRIC_STORAGE, only their upper triangle (diagonal included) is
+ * stored row by row, which halves their size.
+ * Returns the number of values stored for such a matrix.
+ **/
+long getMatrixSize(int nCities) {
+#ifdef SYMMETRIC_STORAGE
+  return (long) nCities * (nCities + 1) / 2;
+#else
+  return (long) nCities * nCities;
+#endif
+}
+
+/**
+ * Index of the edge (i,j) in the upper triangle of a matrix stored row by row
+ **/
+long getPackedEdgeIndex(int i, int j, int nCities) {
+  if (i > j) {
+    int k = i;
+    i = j;
+    j = k;
+  }
+  return (long) i * nCities - (long) i * (i - 1) / 2 + (j - i);
+}
+
+/**
+ * Index of the edge (i,j) in a symmetric matrix
+ * In packed storage, (i,j) and (j,i) have the same index.
+ **/
+long getEdgeIndex(int i, int j, int nCities) {
+#ifdef SYMMETRIC_STORAGE
+  return getPackedEdgeIndex(i, j, nCities);
+#else
+  return (long) i * nCities + j;
+#endif
+}
+
+/**
+ * Cities (i,j) of the edge of index k in a symmetric matrix (i <= j in
+ * packed storage), inverse of getEdgeIndex
+ **/
+void getEdgeCities(long k, int nCities, int* i, int* j) {
+#ifdef SYMMETRIC_STORAGE
+  // row i starts at getPackedEdgeIndex(i, i) : solve the quadratic equation
+  // and fix the rounding of the square root
+  double b = 2.0 * nCities + 1.0;
+  long row = (long) ((b - sqrt(b * b - 8.0 * k)) / 2.0);
+  row = std::max(0L, std::min(row, (long) nCities - 1));
+  while (row > 0 && getPackedEdgeIndex(row, row, nCities) > k) {
+    row--;
+  }
+  while (row < nCities - 1 && getPackedEdgeIndex(row + 1, row + 1, nCities) <= k) {
+    row++;
+  }
+  *i = (int) row;
+  *j = (int) (row + k - getPackedEdgeIndex(row, row, nCities));
+#else
+  *i = (int) (k / nCities);
+  *j = (int) (k % nCities);
+#endif
+}
+
+/**
+ * First column stored for row i of a symmetric matrix
+ **/
+int getFirstStoredColumn(int i) {
+#ifdef SYMMETRIC_STORAGE
+  return i;
+#else
+  return 0;
+#endif
+}
+
+// Types of the distances of a map (size of a distance in bytes)
+// DISTANCE_COORDINATES : no distance is stored, they are computed from the
+// coordinates of the cities
+#define DISTANCE_COORDINATES 0
+#define DISTANCE_UINT8 1
+#define DISTANCE_UINT16 2
+#define DISTANCE_UINT32 4
+
+// Distances computed from the coordinates of the cities (TSPLIB EDGE_WEIGHT_TYPE)
+#define COORDINATES_EUC_2D 0
+#define COORDINATES_CEIL_2D 1
+#define COORDINATES_GEO 2
+#define COORDINATES_ATT 3
+
+// Constants of the GEO distances of TSPLIB
+#define GEO_PI 3.141592
+#define GEO_RADIUS 6378.388
+
+/**
+ * Distances between the cities (symmetric matrix, see getEdgeIndex)
+ * The type of the distances is chosen from the maximal distance of the map
+ * to reduce the memory used and read by the kernels.
+ * Maps given by coordinates only store the coordinates of the cities
+ * (x0 y0 x1 y1 ..., latitudes and longitudes in radians for GEO) and the
+ * metric used to compute their distances. They have no distances matrix.
+ * The distances of a binary map file can be used in place : they then point
+ * into its memory mapping (mapping, mappingSize), which is unmapped at free.
+ **/
+struct DistanceMatrix {
+  int type;
+  void* distances;
+  double* coordinates;
+  int metric;
+  void* mapping;
+  size_t mappingSize;
+};
+
+/**
+ * Returns the smallest type of distances that can store maxDistance
+ **/
+int getDistanceType(long maxDistance) {
+  if (maxDistance <= UINT8_MAX) {
+    return DISTANCE_UINT8;
+  } else if (maxDistance <= UINT16_MAX) {
+    return DISTANCE_UINT16;
+  }
+  return DISTANCE_UINT32;
+}
+
+void allocateDistances(DistanceMatrix* map, int type, int nCities) {
+  map->type = type;
+  map->distances = NULL;
+  map->coordinates = NULL;
+  map->metric = COORDINATES_EUC_2D;
+  map->mapping = NULL;
+  map->mappingSize = 0;
+  if (type == DISTANCE_COORDINATES) {
+    map->coordinates = (double*) malloc(2*nCities*sizeof(double));
+  } else {
+    map->distances = malloc(getMatrixSize(nCities)*type);
+  }
+}
+
+void freeDistances(DistanceMatrix* map) {
+  if (map->mapping != NULL) {
+    munmap(map->mapping, map->mappingSize);
+    map->mapping = NULL;
+  } else {
+    free(map->distances);
+  }
+  free(map->coordinates);
+  map->distances = NULL;
+  map->coordinates = NULL;
+}
+
+/**
+ * Distances read from a matrix of the given type
+ **/
+template <typename Distance>
+struct MatrixDistances {
+  Distance* distances;
+  int nCities;
+  long operator()(int i, int j) const {
+    return distances[getEdgeIndex(i,j,nCities)];
+  }
+};
+
+template <typename Distance>
+MatrixDistances<Distance> getMatrixDistances(DistanceMatrix* map, int nCities) {
+  MatrixDistances<Distance> distance;
+  distance.distances = (Distance*) map->distances;
+  distance.nCities = nCities;
+  return distance;
+}
+
+/**
+ * Distances computed on the fly from the coordinates of the cities, with the
+ * rounding of the TSPLIB metrics
+ **/
+struct CoordinatesDistances {
+  double* coordinates;
+  int metric;
+  long operator()(int i, int j) const {
+    double dx = coordinates[2*i] - coordinates[2*j];
+    double dy = coordinates[2*i + 1] - coordinates[2*j + 1];
+    switch (metric) {
+      case COORDINATES_CEIL_2D:
+        return (long) ceil(sqrt(dx*dx + dy*dy));
+      case COORDINATES_GEO: {
+        double q1 = cos(coordinates[2*i + 1] - coordinates[2*j + 1]);
+        double q2 = cos(dx);
+        double q3 = cos(coordinates[2*i] + coordinates[2*j]);
+        return (long) (GEO_RADIUS * acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+      }
+      case COORDINATES_ATT: {
+        double r = sqrt((dx*dx + dy*dy) / 10.0);
+        long t = (long) (r + 0.5);
+        return (t < r) ? t + 1 : t;
+      }
+      default:
+        return (long) (sqrt(dx*dx + dy*dy) + 0.5);
+    }
+  }
+};
+
+CoordinatesDistances getCoordinatesDistances(DistanceMatrix* map) {
+  CoordinatesDistances distance;
+  distance.coordinates = map->coordinates;
+  distance.metric = map->metric;
+  return distance;
+}
+
+/**
+ * Distance between cities i and j, whatever the type of the map
+ * The kernels use the distances directly (see the dispatchers below).
+ **/
+long getDistance(DistanceMatrix* map, int i, int j, int nCities) {
+  switch (map->type) {
+    case DISTANCE_COORDINATES:
+      return getCoordinatesDistances(map)(i, j);
+    case DISTANCE_UINT8:
+      return getMatrixDistances<uint8_t>(map, nCities)(i, j);
+    case DISTANCE_UINT16:
+      return getMatrixDistances<uint16_t>(map, nCities)(i, j);
+    default:
+      return getMatrixDistances<uint32_t>(map, nCities)(i, j);
+  }
+}
+
+/**
+ * Copy distances into a matrix of the given type
+ **/
+template <typename Distance>
+void copyDistances(Distance* distances, uint32_t* values, long size) {
+  long i;
+  for (i = 0; i < size; i++) {
+    distances[i] = (Distance) values[i];
+  }
+}
+
 void printPath(int* path, int nCities) {
   int i;
   printf("Path : ");
@@ -39,19 +495,36 @@ void printPath(int* path, int nCities) {
   printf("\n");
 }
 
-void printMap(int* map, int nCities) {
+template <typename Distances>
+void printMap(Distances distance, int nCities) {
   printf("\n+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++\n");
   printf("MAP :\n");
-  int i;
-  for (i = 0; i < nCities * nCities; i++) {
-    printf("%d ", map[i]);
-    if (i % nCities == (nCities - 1)) {
-      printf("\n");
+  int i, j;
+  for (i = 0; i < nCities; i++) {
+    for (j = 0; j < nCities; j++) {
+      printf("%ld ", distance(i, j));
     }
+    printf("\n");
   }
   printf("+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++\n\n");
 }
 
+void printMap(DistanceMatrix* map, int nCities) {
+  switch (map->type) {
+    case DISTANCE_COORDINATES:
+      printMap(getCoordinatesDistances(map), nCities);
+      break;
+    case DISTANCE_UINT8:
+      printMap(getMatrixDistances<uint8_t>(map, nCities), nCities);
+      break;
+    case DISTANCE_UINT16:
+      printMap(getMatrixDistances<uint16_t>(map, nCities), nCities);
+      break;
+    default:
+      printMap(getMatrixDistances<uint32_t>(map, nCities), nCities);
+  }
+}
+
 void copyVectorInt(int* in, int* out, int size) {
   int k;
   for (k = 0; k < size; k++) {
@@ -70,30 +543,54 @@ void copyVectordouble(double* in, double* out, int size) {
  * returns the pheromons value of a given path
  *
  **/
-void findPheromonsPath (double* pheromonsPath, int* bestPath, double* pheromons, int nCities) {
+void findPheromonsPath (double* pheromonsPath, int* bestPath, double* pheromons, double pheromonScale, int nCities) {
   int i;
   int previousCity = 0;
   int nextCity = 0;
   for (i = 1; i < nCities; i++) {
     previousCity = bestPath[i - 1];
     nextCity = bestPath[i];
-    pheromonsPath[i-1] = pheromons[getMatrixIndex(previousCity, nextCity, nCities)];
+    pheromonsPath[i-1] = pheromonScale * pheromons[getEdgeIndex(previousCity, nextCity, nCities)];
   }
   // Add end of loop
-  pheromonsPath[nCities - 1] = pheromons[getMatrixIndex(nextCity, bestPath[0], nCities)];
+  pheromonsPath[nCities - 1] = pheromonScale * pheromons[getEdgeIndex(nextCity, bestPath[0], nCities)];
+}
+
+/**
+ * Store the distances of a map read in values, with the smallest type of
+ * distances that can store maxDistance
+ **/
+void setDistances(DistanceMatrix* map, uint32_t* values, uint32_t maxDistance, int nCities) {
+  allocateDistances(map, getDistanceType(maxDistance), nCities);
+  switch (map->type) {
+    case DISTANCE_UINT8:
+      copyDistances((uint8_t*) map->distances, values, getMatrixSize(nCities));
+      break;
+    case DISTANCE_UINT16:
+      copyDistances((uint16_t*) map->distances, values, getMatrixSize(nCities));
+      break;
+    default:
+      copyDistances((uint32_t*) map->distances, values, getMatrixSize(nCities));
+  }
 }
 
 /**
  * Load map from a file given by generate_map.cpp code
+ * The first line gives the number of cities. It is followed either by the
+ * distances matrix, or, when the number of cities is followed by EUC_2D, by
+ * the coordinates of the cities (one "x y" line per city).
+ * A distances matrix is allocated with the smallest type of distances that
+ * can store all its values.
  * Returns 0 if everything is fine
  **/
-int LoadCities(char* file, int* map) {
+int LoadCities(char* file, DistanceMatrix* map, int* nCities) {
   std::ifstream in;
   int matrixFull = 1;
   int size = 0;
   int x = 0;
   int y = 0;
-  int first = 1;
+  uint32_t maxDistance = 0;
+  uint32_t* values = NULL;
 
   in.open (file);
 
@@ -101,162 +598,1569 @@ int LoadCities(char* file, int* map) {
     printf("Cannot open file.\n");
     return -1;
   }
-  char out[8];
+
+  std::string header;
+  char keyword[16] = "";
+  std::getline(in, header);
+  if (sscanf(header.c_str(), "%d %15s", &size, keyword) < 1 || size <= 0) {
+    printf("Wrong map header.\n");
+    in.close();
+    return -1;
+  }
+  *nCities = size;
+
+  if (strcmp(keyword, "EUC_2D") == 0) {
+    allocateDistances(map, DISTANCE_COORDINATES, size);
+    for (x = 0; x < size; x++) {
+      if (!(in >> map->coordinates[2*x] >> map->coordinates[2*x + 1])) {
+        printf("Missing coordinates of city %d.\n", x);
+        in.close();
+        freeDistances(map);
+        return -1;
+      }
+    }
+    in.close();
+    return 0;
+  }
+
+  values = (uint32_t*) malloc(getMatrixSize(size)*sizeof(uint32_t));
+  char out[16];
   while (!in.eof() && matrixFull) {
-    if (first) {
-      first = 0;
-      in >> out;
-      size = atoi(out);
-    } else {
-      in >> out;
-      int index = getMatrixIndex(x,y,size);
-      map[index]= atoi(out);
-      y = (y + 1) % size;
-      if (y == 0) {
-        x = (x + 1) % size;
-        if (x == 0) {
-          matrixFull = 0;
-        }
+    in >> out;
+    long index = getEdgeIndex(x,y,size);
+    values[index] = atol(out);
+    if (values[index] > maxDistance) {
+      maxDistance = values[index];
+    }
+    y = (y + 1) % size;
+    if (y == 0) {
+      x = (x + 1) % size;
+      if (x == 0) {
+        matrixFull = 0;
       }
     }
   }
 
   in.close();
 
+  setDistances(map, values, maxDistance, size);
+  free(values);
+
   return 0;
 }
 
+#define READER_BUFFER_SIZE 65536
+
 /**
- * Compute the probability to go in each city from current city
+ * Buffered reading of a text file, by lines or by numbers
  **/
-void computeProbabilities(int currentCity, double* probabilities, int* path, int* map, int nCities, double* pheromons, double alpha, double beta) {
-  int i;
-  double total = 0;
-  for (i = 0; i < nCities; i++) {
-    if (path[i] != -1 || i == currentCity) {
-      probabilities[i] = 0.0;
-    } else {
-      double p = pow(1.0 / map[getMatrixIndex(currentCity,i,nCities)],alpha) * pow(pheromons[getMatrixIndex(currentCity,i,nCities)], beta);
-      probabilities[i] = p;
-      total += p;
-    }
-  }
+struct FileReader {
+  FILE* file;
+  char buffer[READER_BUFFER_SIZE];
+  size_t size;
+  size_t position;
+};
 
-  // If all the probabilities are really small
-  // We select one (not randomly to have always the same behavior)
-  if (total == 0) {
-    i = 0;
-    for (i = 0; i < nCities; i++) {
-      if (path[i] == -1 && i != currentCity) {
-        probabilities[i] = 1.0;
-        total++;
-      }
+int readChar(FileReader* reader) {
+  if (reader->position == reader->size) {
+    reader->size = fread(reader->buffer, 1, READER_BUFFER_SIZE, reader->file);
+    reader->position = 0;
+    if (reader->size == 0) {
+      return EOF;
     }
   }
-
-  for (i = 0; i < nCities; i++) {
-    probabilities[i] = probabilities[i] / total;
-  }
+  return (unsigned char) reader->buffer[reader->position++];
 }
 
 /**
- * Given the current city, select the next city to go to (for an ant)
+ * Read the next line (truncated to maxLength - 1 characters)
+ * Returns -1 at the end of the file
  **/
-int computeNextCity(int currentCity, int* path, int* map, int nCities, double* pheromons, double alpha, double beta, long random) {
-  int i = 0;
-  double *probabilities;
-  probabilities = (double*) malloc(nCities*sizeof(double));
-  computeProbabilities(currentCity, probabilities, path, map, nCities, pheromons, alpha, beta);
-
-  int value = (random % 100) + 1;
-  int sum = 0;
-
-  for (i = 0; i < nCities; i++) {
-    sum += ceilf(probabilities[i] * 100);
-    if (sum >= value) {
-      free(probabilities);
-      return i;
+int readLine(FileReader* reader, char* line, int maxLength) {
+  int length = 0;
+  int c = readChar(reader);
+  if (c == EOF) {
+    return -1;
+  }
+  while (c != EOF && c != '\n') {
+    if (length < maxLength - 1) {
+      line[length] = (char) c;
+      length++;
     }
+    c = readChar(reader);
   }
-  free(probabilities);
-  return -1;
+  line[length] = '\0';
+  return 0;
 }
 
 /**
- * Compute the cost of the new path and returns the best cost between the current best and the one
- * from the new path.
+ * Read the next number, whatever the spaces and line breaks before it
+ * Returns -1 at the end of the file or if the next word is not a number
  **/
-long computeCost(long bestCost, int* bestPath, int* currentPath, int* map, int nCities) {
-  // compute currentCost
-  int i;
-  long currentCost = 0;
-  int* orderedCities = (int*) malloc(nCities*sizeof(int));
-
-  for (i = 0; i < nCities; i++) {
-    orderedCities[currentPath[i]] = i;
+int readNumber(FileReader* reader, double* value) {
+  char word[64];
+  int length = 0;
+  int c = readChar(reader);
+  while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+    c = readChar(reader);
   }
-  for (i = 0; i < nCities - 1; i++) {
-    currentCost += map[getMatrixIndex(orderedCities[i],orderedCities[i + 1], nCities)];
+  while (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+    if (length < 63) {
+      word[length] = (char) c;
+      length++;
+    }
+    c = readChar(reader);
   }
-  // add last
-  currentCost += map[getMatrixIndex(orderedCities[nCities - 1], orderedCities[0], nCities)];
-
-  if (bestCost > currentCost) {
-    return currentCost;
-  } else {
-    return bestCost;
+  if (length == 0) {
+    return -1;
   }
+  word[length] = '\0';
+  char* end;
+  *value = strtod(word, &end);
+  return (*end == '\0') ? 0 : -1;
 }
 
 /**
- * Update the pheromons in the pheromons matrix given the current path
- *
- * The maximum pheromon value for an edge is 1.
+ * Convert TSPLIB GEO coordinates (DDD.MM degrees and minutes) to radians
  **/
-void updatePheromons(double* pheromons, int* path, long cost, int nCities) {
-  int i;
-  int* orderedCities = (int*) malloc(nCities*sizeof(int));
+double geoToRadians(double coordinate) {
+  int degrees = (int) coordinate;
+  double minutes = coordinate - degrees;
+  return GEO_PI * (degrees + 5.0 * minutes / 3.0) / 180.0;
+}
 
-  for (i = 0; i < nCities; i++) {
-    int order = path[i];
-    orderedCities[order] = i;
+/**
+ * Load a TSPLIB symmetric TSP instance
+ * EUC_2D, CEIL_2D, GEO and ATT instances are loaded with their coordinates
+ * (distances computed on the fly), EXPLICIT ones as a distances matrix
+ * (FULL_MATRIX, UPPER_ROW, LOWER_ROW, UPPER_DIAG_ROW or LOWER_DIAG_ROW).
+ * Returns 0 if everything is fine
+ **/
+int LoadTSPLIB(char* file, DistanceMatrix* map, int* nCities) {
+  FileReader* reader = (FileReader*) malloc(sizeof(FileReader));
+  char line[256];
+  char key[64];
+  char value[64];
+  char weightType[64] = "";
+  char weightFormat[64] = "";
+  int size = 0;
+  int inSection = 0;
+  int i, j;
+  double x, y;
+
+  reader->file = fopen(file, "r");
+  reader->size = 0;
+  reader->position = 0;
+  if (reader->file == NULL) {
+    printf("Cannot open file.\n");
+    free(reader);
+    return -1;
   }
 
-  for (i = 0; i < nCities - 1; i++) {
-    pheromons[getMatrixIndex(orderedCities[i],orderedCities[i + 1], nCities)] += 1.0/cost;
-    pheromons[getMatrixIndex(orderedCities[i + 1],orderedCities[i], nCities)] += 1.0/cost;
-    if (pheromons[getMatrixIndex(orderedCities[i],orderedCities[i + 1], nCities)] > 1) {
-      pheromons[getMatrixIndex(orderedCities[i],orderedCities[i + 1], nCities)] = 1.0;
-      pheromons[getMatrixIndex(orderedCities[i + 1],orderedCities[i], nCities)] = 1.0;
+  // Read the specification part, up to the data section
+  while (!inSection && readLine(reader, line, sizeof(line)) == 0) {
+    value[0] = '\0';
+    if (sscanf(line, " %63[^: \t\r] : %63s", key, value) < 1) {
+      continue;
+    }
+    if (strcmp(key, "DIMENSION") == 0) {
+      size = atoi(value);
+    } else if (strcmp(key, "TYPE") == 0 && strcmp(value, "TSP") != 0) {
+      printf("Unsupported TSPLIB type %s.\n", value);
+      fclose(reader->file);
+      free(reader);
+      return -1;
+    } else if (strcmp(key, "EDGE_WEIGHT_TYPE") == 0) {
+      strcpy(weightType, value);
+    } else if (strcmp(key, "EDGE_WEIGHT_FORMAT") == 0) {
+      strcpy(weightFormat, value);
+    } else if (strcmp(key, "NODE_COORD_SECTION") == 0 || strcmp(key, "EDGE_WEIGHT_SECTION") == 0) {
+      inSection = 1;
     }
   }
-  // add last
-  pheromons[getMatrixIndex(orderedCities[nCities - 1],orderedCities[0],nCities)] += 1.0/cost;
-  pheromons[getMatrixIndex(orderedCities[0],orderedCities[nCities - 1], nCities)] += 1.0/cost;
-  if (pheromons[getMatrixIndex(orderedCities[nCities - 1],orderedCities[0],nCities)] > 1.0) {
-    pheromons[getMatrixIndex(orderedCities[nCities - 1],orderedCities[0],nCities)] = 1.0;
-    pheromons[getMatrixIndex(orderedCities[0],orderedCities[nCities - 1], nCities)] = 1.0;
+
+  if (!inSection || size <= 0) {
+    printf("Wrong TSPLIB header.\n");
+    fclose(reader->file);
+    free(reader);
+    return -1;
   }
-}
+  *nCities = size;
 
-#if __linux__ 
+  if (strcmp(weightType, "EXPLICIT") == 0) {
+    int full = strcmp(weightFormat, "FULL_MATRIX") == 0;
+    int upper = strcmp(weightFormat, "UPPER_ROW") == 0 || strcmp(weightFormat, "UPPER_DIAG_ROW") == 0;
+    int diagonal = full || strcmp(weightFormat, "UPPER_DIAG_ROW") == 0 || strcmp(weightFormat, "LOWER_DIAG_ROW") == 0;
+    if (!full && !upper && strcmp(weightFormat, "LOWER_ROW") != 0 && strcmp(weightFormat, "LOWER_DIAG_ROW") != 0) {
+      printf("Unsupported TSPLIB EDGE_WEIGHT_FORMAT %s.\n", weightFormat);
+      fclose(reader->file);
+      free(reader);
+      return -1;
+    }
 
-#include <sys/time.h>
+    uint32_t maxDistance = 0;
+    uint32_t* values = (uint32_t*) calloc(getMatrixSize(size), sizeof(uint32_t));
+    for (i = 0; i < size; i++) {
+      // columns of row i given by the format
+      int first = 0;
+      int last = size;
+      if (upper) {
+        first = diagonal ? i : i + 1;
+      } else if (!full) {
+        last = diagonal ? i + 1 : i;
+      }
+      for (j = first; j < last; j++) {
+        if (readNumber(reader, &x) || x < 0) {
+          printf("Missing distance (%d,%d).\n", i, j);
+          fclose(reader->file);
+          free(reader);
+          free(values);
+          return -1;
+        }
+        uint32_t distance = (uint32_t) x;
+        values[getEdgeIndex(i,j,size)] = distance;
+        if (!full) {
+          values[getEdgeIndex(j,i,size)] = distance;
+        }
+        if (distance > maxDistance) {
+          maxDistance = distance;
+        }
+      }
+    }
+    setDistances(map, values, maxDistance, size);
+    free(values);
+  } else {
+    allocateDistances(map, DISTANCE_COORDINATES, size);
+    if (strcmp(weightType, "EUC_2D") == 0) {
+      map->metric = COORDINATES_EUC_2D;
+    } else if (strcmp(weightType, "CEIL_2D") == 0) {
+      map->metric = COORDINATES_CEIL_2D;
+    } else if (strcmp(weightType, "GEO") == 0) {
+      map->metric = COORDINATES_GEO;
+    } else if (strcmp(weightType, "ATT") == 0) {
+      map->metric = COORDINATES_ATT;
+    } else {
+      printf("Unsupported TSPLIB EDGE_WEIGHT_TYPE %s.\n", weightType);
+      fclose(reader->file);
+      free(reader);
+      freeDistances(map);
+      return -1;
+    }
 
-double second() {
-  struct timeval tp;
-  struct timezone tzp;
-  gettimeofday(&tp,&tzp);
-  return ( (double) tp.tv_sec + (double) tp.tv_usec * 1.e-6 );
+    double id;
+    for (i = 0; i < size; i++) {
+      if (readNumber(reader, &id) || readNumber(reader, &x) || readNumber(reader, &y) || id < 1 || id > size) {
+        printf("Wrong coordinates of city %d.\n", i + 1);
+        fclose(reader->file);
+        free(reader);
+        freeDistances(map);
+        return -1;
+      }
+      j = (int) id - 1;
+      if (map->metric == COORDINATES_GEO) {
+        x = geoToRadians(x);
+        y = geoToRadians(y);
+      }
+      map->coordinates[2*j] = x;
+      map->coordinates[2*j + 1] = y;
+    }
+  }
+
+  fclose(reader->file);
+  free(reader);
+  return 0;
 }
-#elif _WIN32
 
-#define M_PI 3.14159265359
+// Binary map files (see convert_map.cpp)
+#define BINARY_MAP_MAGIC "ACOM"
+#define BINARY_MAP_VERSION 1
 
-double second() {
-  SYSTEMTIME st;
-  GetSystemTime(&st);
-  return ( (double)  st.wSecond + (double) st.wMilliseconds * 1.e-6 );
+/**
+ * Header of a binary map file
+ * It is followed by the coordinates of the cities (2 * nCities doubles) when
+ * type is DISTANCE_COORDINATES, otherwise by the distances matrix with
+ * elements of type bytes : its upper triangle row by row (diagonal included)
+ * when symmetric is 1, the full matrix otherwise. The checksum is the one of
+ * these data (see computeChecksum).
+ **/
+struct BinaryMapHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t nCities;
+  uint32_t type;
+  uint32_t metric;
+  uint32_t symmetric;
+  uint64_t checksum;
+};
+
+/**
+ * Size in bytes of the data following the header of a binary map file
+ **/
+size_t getBinaryMapDataSize(BinaryMapHeader* header) {
+  size_t n = header->nCities;
+  if (header->type == DISTANCE_COORDINATES) {
+    return 2 * n * sizeof(double);
+  } else if (header->symmetric) {
+    return n * (n + 1) / 2 * header->type;
+  }
+  return n * n * header->type;
 }
-#endif
 
+/**
+ * Checksum of the data of a binary map file, computed by 8 bytes words
+ **/
+uint64_t computeChecksum(const unsigned char* data, size_t size) {
+  uint64_t checksum = 14695981039346656037ULL;
+  size_t i;
+  for (i = 0; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    checksum = (checksum ^ word) * 1099511628211ULL;
+  }
+  for (; i < size; i++) {
+    checksum = (checksum ^ data[i]) * 1099511628211ULL;
+  }
+  return checksum;
+}
+
+/**
+ * Copy the distances of a binary map file (packed if symmetric) into a
+ * distances matrix
+ **/
+template <typename Distance>
+void copyBinaryDistances(Distance* distances, const Distance* values, int nCities, int symmetric) {
+  int i, j;
+  for (i = 0; i < nCities; i++) {
+    for (j = getFirstStoredColumn(i); j < nCities; j++) {
+      long index = symmetric ? getPackedEdgeIndex(i,j,nCities) : (long) i * nCities + j;
+      distances[getEdgeIndex(i,j,nCities)] = values[index];
+    }
+  }
+}
+
+/**
+ * Load a binary map file created by convert_map
+ * The file is memory mapped. Its distances are used in place when they are
+ * stored like the distances matrix of this build (full or packed), so that
+ * nothing has to be parsed nor copied.
+ * Returns 0 if everything is fine
+ **/
+int LoadBinaryMap(char* file, DistanceMatrix* map, int* nCities) {
+  int fd = open(file, O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0) {
+    printf("Cannot open file.\n");
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  size_t fileSize = status.st_size;
+  if (fileSize < sizeof(BinaryMapHeader)) {
+    printf("Wrong binary map header.\n");
+    close(fd);
+    return -1;
+  }
+  void* mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    printf("Cannot map file.\n");
+    return -1;
+  }
+
+  BinaryMapHeader* header = (BinaryMapHeader*) mapping;
+  unsigned char* data = (unsigned char*) mapping + sizeof(BinaryMapHeader);
+  if (memcmp(header->magic, BINARY_MAP_MAGIC, 4) != 0 || header->version != BINARY_MAP_VERSION || header->nCities == 0 ||
+      (header->type != DISTANCE_COORDINATES && header->type != DISTANCE_UINT8 && header->type != DISTANCE_UINT16 && header->type != DISTANCE_UINT32) ||
+      fileSize != sizeof(BinaryMapHeader) + getBinaryMapDataSize(header)) {
+    printf("Wrong binary map header.\n");
+    munmap(mapping, fileSize);
+    return -1;
+  }
+  if (computeChecksum(data, getBinaryMapDataSize(header)) != header->checksum) {
+    printf("Wrong binary map checksum.\n");
+    munmap(mapping, fileSize);
+    return -1;
+  }
+
+  int size = header->nCities;
+  *nCities = size;
+  int packed = 0;
+#ifdef SYMMETRIC_STORAGE
+  packed = 1;
+#endif
+
+  if (header->type == DISTANCE_COORDINATES) {
+    allocateDistances(map, DISTANCE_COORDINATES, size);
+    map->metric = header->metric;
+    memcpy(map->coordinates, data, getBinaryMapDataSize(header));
+  } else if ((int) header->symmetric == packed) {
+    map->type = header->type;
+    map->distances = data;
+    map->coordinates = NULL;
+    map->metric = COORDINATES_EUC_2D;
+    map->mapping = mapping;
+    map->mappingSize = fileSize;
+    return 0;
+  } else if (!header->symmetric && packed) {
+    printf("The binary map is not symmetric.\n");
+    munmap(mapping, fileSize);
+    return -1;
+  } else {
+    allocateDistances(map, header->type, size);
+    switch (map->type) {
+      case DISTANCE_UINT8:
+        copyBinaryDistances((uint8_t*) map->distances, (uint8_t*) data, size, header->symmetric);
+        break;
+      case DISTANCE_UINT16:
+        copyBinaryDistances((uint16_t*) map->distances, (uint16_t*) data, size, header->symmetric);
+        break;
+      default:
+        copyBinaryDistances((uint32_t*) map->distances, (uint32_t*) data, size, header->symmetric);
+    }
+  }
+
+  munmap(mapping, fileSize);
+  return 0;
+}
+
+/**
+ * Copy a distances matrix into the data of a binary map file (only its upper
+ * triangle if symmetric)
+ **/
+template <typename Distance>
+void packBinaryDistances(Distance* values, Distance* distances, int nCities, int symmetric) {
+  int i, j;
+  long k = 0;
+  for (i = 0; i < nCities; i++) {
+    for (j = symmetric ? i : 0; j < nCities; j++) {
+      values[k] = distances[getEdgeIndex(i,j,nCities)];
+      k++;
+    }
+  }
+}
+
+/**
+ * Save a map as a binary map file
+ * The distances matrix is stored as an upper triangle when it is symmetric.
+ * Returns 0 if everything is fine
+ **/
+int SaveBinaryMap(char* file, DistanceMatrix* map, int nCities) {
+  BinaryMapHeader header;
+  int i, j;
+
+  memcpy(header.magic, BINARY_MAP_MAGIC, 4);
+  header.version = BINARY_MAP_VERSION;
+  header.nCities = nCities;
+  header.type = map->type;
+  header.metric = (map->type == DISTANCE_COORDINATES) ? map->metric : 0;
+  header.symmetric = 1;
+  for (i = 0; i < nCities && header.symmetric; i++) {
+    for (j = i + 1; j < nCities; j++) {
+      if (getDistance(map, i, j, nCities) != getDistance(map, j, i, nCities)) {
+        header.symmetric = 0;
+        break;
+      }
+    }
+  }
+
+  size_t dataSize = getBinaryMapDataSize(&header);
+  unsigned char* data = (unsigned char*) malloc(dataSize);
+  switch (map->type) {
+    case DISTANCE_COORDINATES:
+      memcpy(data, map->coordinates, dataSize);
+      break;
+    case DISTANCE_UINT8:
+      packBinaryDistances((uint8_t*) data, (uint8_t*) map->distances, nCities, header.symmetric);
+      break;
+    case DISTANCE_UINT16:
+      packBinaryDistances((uint16_t*) data, (uint16_t*) map->distances, nCities, header.symmetric);
+      break;
+    default:
+      packBinaryDistances((uint32_t*) data, (uint32_t*) map->distances, nCities, header.symmetric);
+  }
+  header.checksum = computeChecksum(data, dataSize);
+
+  FILE* out = fopen(file, "wb");
+  if (out == NULL) {
+    printf("Cannot open file.\n");
+    free(data);
+    return -1;
+  }
+  int error = fwrite(&header, sizeof(BinaryMapHeader), 1, out) != 1 || fwrite(data, 1, dataSize, out) != dataSize;
+  error = (fclose(out) != 0) || error;
+  free(data);
+  if (error) {
+    printf("Cannot write file.\n");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Load a map given either by generate_map.cpp (the file starts with the number
+ * of cities), by convert_map (binary) or in the TSPLIB format, and its number
+ * of cities
+ * Returns 0 if everything is fine
+ **/
+int LoadMap(char* file, DistanceMatrix* map, int* nCities) {
+  FILE* in = fopen(file, "r");
+  if (in == NULL) {
+    printf("Cannot open file.\n");
+    return -1;
+  }
+  char magic[4];
+  if (fread(magic, 1, 4, in) == 4 && memcmp(magic, BINARY_MAP_MAGIC, 4) == 0) {
+    fclose(in);
+    return LoadBinaryMap(file, map, nCities);
+  }
+  rewind(in);
+  int c = fgetc(in);
+  while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+    c = fgetc(in);
+  }
+  fclose(in);
+
+  if (c >= '0' && c <= '9') {
+    return LoadCities(file, map, nCities);
+  }
+  return LoadTSPLIB(file, map, nCities);
+}
+
+// Binary random numbers files (see convert_map.cpp)
+#define BINARY_RANDOM_MAGIC "ACOR"
+#define BINARY_RANDOM_VERSION 1
+
+/**
+ * Header of a binary random numbers file
+ * It is followed by the random numbers (nRandomNumbers int64_t), with their
+ * checksum (see computeChecksum).
+ **/
+struct BinaryRandomHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t nRandomNumbers;
+  uint64_t checksum;
+};
+
+/**
+ * Load the random numbers of a file given by generate_random_numbers.cpp, or
+ * of a binary random numbers file
+ * randomNumbers is allocated (to free by the caller)
+ * Returns 0 if everything is fine
+ **/
+int LoadRandomNumbers(char* file, long** randomNumbers, long* nRandomNumbers) {
+  long i;
+  FILE* binary = fopen(file, "rb");
+  if (binary == NULL) {
+    printf("Cannot open file.\n");
+    return -1;
+  }
+  BinaryRandomHeader header;
+  if (fread(&header, sizeof(BinaryRandomHeader), 1, binary) == 1 && memcmp(header.magic, BINARY_RANDOM_MAGIC, 4) == 0) {
+    int64_t* values = (int64_t*) malloc(header.nRandomNumbers*sizeof(int64_t));
+    if (header.version != BINARY_RANDOM_VERSION ||
+        fread(values, sizeof(int64_t), header.nRandomNumbers, binary) != header.nRandomNumbers ||
+        computeChecksum((unsigned char*) values, header.nRandomNumbers*sizeof(int64_t)) != header.checksum) {
+      printf("Wrong binary random numbers file.\n");
+      fclose(binary);
+      free(values);
+      return -1;
+    }
+    fclose(binary);
+    *nRandomNumbers = header.nRandomNumbers;
+    *randomNumbers = (long*) malloc(*nRandomNumbers*sizeof(long));
+    for (i = 0; i < *nRandomNumbers; i++) {
+      (*randomNumbers)[i] = values[i];
+    }
+    free(values);
+    return 0;
+  }
+  fclose(binary);
+
+  std::ifstream in;
+  in.open(file);
+  if (!in.is_open()) {
+    printf("Cannot open file.\n");
+    return -1;
+  }
+
+  char out[20];
+  in >> out;
+
+  // Define number of random numbers
+  *nRandomNumbers = atol(out);
+
+  // Allocation of random numbers vector
+  *randomNumbers = (long*) malloc(*nRandomNumbers*sizeof(long));
+
+  for (i = 0; i < *nRandomNumbers; i++) {
+    (*randomNumbers)[i] = 0;
+  }
+
+  i = 0;
+  while (i < *nRandomNumbers && in >> out) {
+    (*randomNumbers)[i] = atol(out);
+    i++;
+  }
+
+  in.close();
+  return 0;
+}
+
+/**
+ * Save random numbers as a binary random numbers file
+ * Returns 0 if everything is fine
+ **/
+int SaveBinaryRandomNumbers(char* file, long* randomNumbers, long nRandomNumbers) {
+  BinaryRandomHeader header;
+  long i;
+
+  int64_t* values = (int64_t*) malloc(nRandomNumbers*sizeof(int64_t));
+  for (i = 0; i < nRandomNumbers; i++) {
+    values[i] = randomNumbers[i];
+  }
+  memcpy(header.magic, BINARY_RANDOM_MAGIC, 4);
+  header.version = BINARY_RANDOM_VERSION;
+  header.nRandomNumbers = nRandomNumbers;
+  header.checksum = computeChecksum((unsigned char*) values, nRandomNumbers*sizeof(int64_t));
+
+  FILE* out = fopen(file, "wb");
+  if (out == NULL) {
+    printf("Cannot open file.\n");
+    free(values);
+    return -1;
+  }
+  int error = fwrite(&header, sizeof(BinaryRandomHeader), 1, out) != 1 || fwrite(values, sizeof(int64_t), nRandomNumbers, out) != (size_t) nRandomNumbers;
+  error = (fclose(out) != 0) || error;
+  free(values);
+  if (error) {
+    printf("Cannot write file.\n");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Static part of the choice information : heuristic(i,j) = (1/d(i,j))^alpha
+ * The map never changes during a run, so it is computed only once in values.
+ * For maps given by coordinates, values is NULL and the heuristic is computed on the fly
+ * from the coordinates, so that no matrix of distances is needed. Only the heuristic
+ * of the candidate lists edges is then kept in neighbourValues (see cacheNeighboursHeuristic) :
+ * neighbourValues[i][n] is the heuristic of the edge from i to neighbours[i][n].
+ **/
+struct Heuristic {
+  double* values;
+  DistanceMatrix* map;
+  double alpha;
+  int nCities;
+  double* neighbourValues;
+  int* neighbours;
+  int nNeighbours;
+};
+
+double computeHeuristicValue(long distance, double alpha) {
+  // cities at the same place (euclidean maps) are considered as 1 unit away
+  if (distance < 1) {
+    distance = 1;
+  }
+  return pow(1.0 / distance, alpha);
+}
+
+template <typename Distances>
+void computeHeuristicValues(double* values, Distances distance, int nCities, double alpha) {
+  int i, j;
+  for (i = 0; i < nCities; i++) {
+    for (j = getFirstStoredColumn(i); j < nCities; j++) {
+      if (i == j) {
+        values[getEdgeIndex(i,j,nCities)] = 0.0;
+      } else {
+        values[getEdgeIndex(i,j,nCities)] = computeHeuristicValue(distance(i, j), alpha);
+      }
+    }
+  }
+}
+
+/**
+ * Initialize the heuristic of a map with its values computed in values
+ * (getMatrixSize(nCities) values, owned by the caller). With coordinates,
+ * the heuristic is computed on the fly and values is not used.
+ **/
+void computeHeuristicIn(Heuristic* heuristic, double* values, DistanceMatrix* map, int nCities, double alpha) {
+  heuristic->map = map;
+  heuristic->alpha = alpha;
+  heuristic->nCities = nCities;
+  heuristic->values = values;
+  heuristic->neighbourValues = NULL;
+  heuristic->neighbours = NULL;
+  heuristic->nNeighbours = 0;
+  switch (map->type) {
+    case DISTANCE_COORDINATES:
+      heuristic->values = NULL;
+      break;
+    case DISTANCE_UINT8:
+      computeHeuristicValues(values, getMatrixDistances<uint8_t>(map, nCities), nCities, alpha);
+      break;
+    case DISTANCE_UINT16:
+      computeHeuristicValues(values, getMatrixDistances<uint16_t>(map, nCities), nCities, alpha);
+      break;
+    default:
+      computeHeuristicValues(values, getMatrixDistances<uint32_t>(map, nCities), nCities, alpha);
+  }
+}
+
+/**
+ * Initialize the heuristic of a map (to free with freeHeuristic)
+ **/
+void computeHeuristic(Heuristic* heuristic, DistanceMatrix* map, int nCities, double alpha) {
+  double* values = NULL;
+  if (map->type != DISTANCE_COORDINATES) {
+    values = (double*) malloc(getMatrixSize(nCities)*sizeof(double));
+  }
+  computeHeuristicIn(heuristic, values, map, nCities, alpha);
+}
+
+/**
+ * Keep the heuristic of the edges of the candidate lists (nNeighbours nearest
+ * neighbours of each city, see computeNearestNeighbours) of a map given by
+ * coordinates, so that it is not computed again each time the choice
+ * information of these edges is updated. Nothing is done if the heuristic
+ * values are stored or if there is no candidate list.
+ **/
+void cacheNeighboursHeuristic(Heuristic* heuristic, int* nearestNeighbours, int nNeighbours) {
+  int i, n;
+  if (heuristic->values != NULL || nearestNeighbours == NULL) {
+    return;
+  }
+  CoordinatesDistances distance = getCoordinatesDistances(heuristic->map);
+  heuristic->neighbourValues = (double*) malloc((long) heuristic->nCities*nNeighbours*sizeof(double));
+  heuristic->neighbours = nearestNeighbours;
+  heuristic->nNeighbours = nNeighbours;
+  for (i = 0; i < heuristic->nCities; i++) {
+    for (n = 0; n < nNeighbours; n++) {
+      long k = getMatrixIndex(i,n,nNeighbours);
+      heuristic->neighbourValues[k] = computeHeuristicValue(distance(i, nearestNeighbours[k]), heuristic->alpha);
+    }
+  }
+}
+
+void freeHeuristic(Heuristic* heuristic) {
+  free(heuristic->values);
+  free(heuristic->neighbourValues);
+  heuristic->values = NULL;
+  heuristic->neighbourValues = NULL;
+}
+
+double getHeuristic(Heuristic* heuristic, int i, int j) {
+  if (heuristic->values != NULL) {
+    return heuristic->values[getEdgeIndex(i,j,heuristic->nCities)];
+  }
+  if (i == j) {
+    return 0.0;
+  }
+  if (heuristic->neighbourValues != NULL) {
+    int n;
+    int* candidates = &heuristic->neighbours[getMatrixIndex(i,0,heuristic->nNeighbours)];
+    for (n = 0; n < heuristic->nNeighbours; n++) {
+      if (candidates[n] == j) {
+        return heuristic->neighbourValues[getMatrixIndex(i,n,heuristic->nNeighbours)];
+      }
+    }
+  }
+  return computeHeuristicValue(getCoordinatesDistances(heuristic->map)(i, j), heuristic->alpha);
+}
+
+/**
+ * Update the choice information used to build the paths :
+ * choiceInfo[i][j] = heuristic[i][j] * pheromons[i][j]^beta
+ * The scale of the pheromons matrix is common to all edges and does not change
+ * the choice of the next city, so it is not applied.
+ * It has to be called each time the whole pheromons matrix changes.
+ **/
+void updateChoiceInfo(double* choiceInfo, Heuristic* heuristic, double* pheromons, int nCities, double beta) {
+  if (heuristic->values != NULL) {
+    long j;
+    for (j = 0; j < getMatrixSize(nCities); j++) {
+      choiceInfo[j] = heuristic->values[j] * pow(pheromons[j], beta);
+    }
+    return;
+  }
+  // position of each city in the candidate list of the current row (-1 if not in it)
+  int i, j, n;
+  int nNeighbours = (heuristic->neighbourValues != NULL) ? heuristic->nNeighbours : 0;
+  int* position = (int*) malloc(nCities*sizeof(int));
+  CoordinatesDistances distance = getCoordinatesDistances(heuristic->map);
+  for (j = 0; j < nCities; j++) {
+    position[j] = -1;
+  }
+  for (i = 0; i < nCities; i++) {
+    int* candidates = &heuristic->neighbours[getMatrixIndex(i,0,nNeighbours)];
+    double* cached = &heuristic->neighbourValues[getMatrixIndex(i,0,nNeighbours)];
+    for (n = 0; n < nNeighbours; n++) {
+      position[candidates[n]] = n;
+    }
+    for (j = getFirstStoredColumn(i); j < nCities; j++) {
+      long k = getEdgeIndex(i,j,nCities);
+      double value;
+      if (i == j) {
+        value = 0.0;
+      } else if (position[j] != -1) {
+        value = cached[position[j]];
+      } else {
+        value = computeHeuristicValue(distance(i, j), heuristic->alpha);
+      }
+      choiceInfo[k] = value * pow(pheromons[k], beta);
+    }
+    for (n = 0; n < nNeighbours; n++) {
+      position[candidates[n]] = -1;
+    }
+  }
+  free(position);
+}
+
+/**
+ * Update the choice information of the edges of a path only (cities in visit order)
+ **/
+void updateChoiceInfoPath(double* choiceInfo, Heuristic* heuristic, double* pheromons, int* path, int nCities, double beta) {
+  int i;
+  for (i = 0; i < nCities; i++) {
+    int a = path[i];
+    int b = path[(i + 1) % nCities];
+    long j = getEdgeIndex(a, b, nCities);
+    long k = getEdgeIndex(b, a, nCities);
+    choiceInfo[j] = getHeuristic(heuristic, a, b) * pow(pheromons[j], beta);
+    if (k != j) {
+      choiceInfo[k] = getHeuristic(heuristic, b, a) * pow(pheromons[k], beta);
+    }
+  }
+}
+
+/**
+ * Update the choice information of the edge of index k only
+ **/
+void updateChoiceInfoEdge(double* choiceInfo, Heuristic* heuristic, double* pheromons, long k, int nCities, double beta) {
+  int i, j;
+  getEdgeCities(k, nCities, &i, &j);
+  choiceInfo[k] = getHeuristic(heuristic, i, j) * pow(pheromons[k], beta);
+}
+
+/**
+ * Order cities by increasing distance from a given city (ties are broken by index)
+ **/
+struct NeighbourOrder {
+  long* distances;
+  bool operator()(int a, int b) const {
+    if (distances[a] != distances[b]) {
+      return distances[a] < distances[b];
+    }
+    return a < b;
+  }
+};
+
+/**
+ * Compute the candidate lists : for each city, its nNeighbours nearest cities
+ * sorted by increasing distance.
+ * Returns a nCities x nNeighbours matrix (to free by the caller)
+ **/
+template <typename Distances>
+int* computeNearestNeighbours(Distances distance, int nCities, int nNeighbours) {
+  int i, j;
+  int* nearestNeighbours = (int*) malloc(nCities*nNeighbours*sizeof(int));
+  int* cities = (int*) malloc(nCities*sizeof(int));
+  long* distances = (long*) malloc(nCities*sizeof(long));
+
+  for (i = 0; i < nCities; i++) {
+    int nOthers = 0;
+    for (j = 0; j < nCities; j++) {
+      distances[j] = distance(i, j);
+      if (j != i) {
+        cities[nOthers] = j;
+        nOthers++;
+      }
+    }
+    NeighbourOrder order;
+    order.distances = distances;
+    std::partial_sort(cities, cities + nNeighbours, cities + nOthers, order);
+    for (j = 0; j < nNeighbours; j++) {
+      nearestNeighbours[getMatrixIndex(i,j,nNeighbours)] = cities[j];
+    }
+  }
+
+  free(cities);
+  free(distances);
+  return nearestNeighbours;
+}
+
+int* computeNearestNeighbours(DistanceMatrix* map, int nCities, int nNeighbours) {
+  switch (map->type) {
+    case DISTANCE_COORDINATES:
+      return computeNearestNeighbours(getCoordinatesDistances(map), nCities, nNeighbours);
+    case DISTANCE_UINT8:
+      return computeNearestNeighbours(getMatrixDistances<uint8_t>(map, nCities), nCities, nNeighbours);
+    case DISTANCE_UINT16:
+      return computeNearestNeighbours(getMatrixDistances<uint16_t>(map, nCities), nCities, nNeighbours);
+    default:
+      return computeNearestNeighbours(getMatrixDistances<uint32_t>(map, nCities), nCities, nNeighbours);
+  }
+}
+
+/**
+ * Compute the weight of each candidate city from current city, stored in weights,
+ * and their total.
+ * Returns the number of candidates that are not visited yet (0 means that the
+ * candidate list is exhausted and that all cities have to be scanned)
+ **/
+int computeCandidateWeights(int currentCity, double* weights, double* total, int* candidates, int nCandidates, int* unvisitedIndex, double* choiceInfo, int nCities) {
+  int i;
+  int nUnvisited = 0;
+  *total = 0;
+  for (i = 0; i < nCandidates; i++) {
+    int city = candidates[i];
+    if (unvisitedIndex[city] == -1) {
+      weights[i] = 0.0;
+    } else {
+      weights[i] = choiceInfo[getEdgeIndex(currentCity,city,nCities)];
+      *total += weights[i];
+      nUnvisited++;
+    }
+  }
+
+  // Same behavior as computeWeights if all the weights are really small
+  if (nUnvisited > 0 && *total == 0) {
+    for (i = 0; i < nCandidates; i++) {
+      if (unvisitedIndex[candidates[i]] != -1) {
+        weights[i] = 1.0;
+        *total += 1.0;
+      }
+    }
+  }
+
+  return nUnvisited;
+}
+
+/**
+ * Weights kernels : compute the weight of each city of a list (the cities not
+ * visited yet) from a row of the choice information matrix, and return the
+ * total of the weights.
+ * The scalar kernel is the reference implementation. The SIMD kernels are
+ * selected at runtime depending on the instructions supported by the CPU
+ * (see check_weights_kernels.cpp). Every kernel sums the weights in
+ * WEIGHTS_LANES partial sums (the weight k goes in the lane k % WEIGHTS_LANES),
+ * combined by sumWeightsLanes, then adds the remaining weights in order : the
+ * totals are the same whatever the instructions, so that nodes with different
+ * CPUs make the same roulette choices.
+ **/
+typedef double (*WeightsKernel)(double* weights, double* choiceRow, int* cities, int nCities);
+
+#define WEIGHTS_LANES 8
+
+/**
+ * Combine the partial sums of the lanes, always in the same order
+ **/
+double sumWeightsLanes(double* lanes) {
+  double low = (lanes[0] + lanes[4]) + (lanes[2] + lanes[6]);
+  double high = (lanes[1] + lanes[5]) + (lanes[3] + lanes[7]);
+  return low + high;
+}
+
+double computeWeightsScalar(double* weights, double* choiceRow, int* cities, int nCities) {
+  int i, j;
+  double lanes[WEIGHTS_LANES] = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (i = 0; i + WEIGHTS_LANES <= nCities; i += WEIGHTS_LANES) {
+    for (j = 0; j < WEIGHTS_LANES; j++) {
+      weights[i + j] = choiceRow[cities[i + j]];
+      lanes[j] += weights[i + j];
+    }
+  }
+  double total = sumWeightsLanes(lanes);
+  for (; i < nCities; i++) {
+    weights[i] = choiceRow[cities[i]];
+    total += weights[i];
+  }
+  return total;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && (__GNUC__ >= 5)
+#define SIMD_KERNELS 1
+#include <immintrin.h>
+
+__attribute__((target("sse2")))
+double computeWeightsSSE2(double* weights, double* choiceRow, int* cities, int nCities) {
+  int i, j;
+  double lanes[WEIGHTS_LANES];
+  __m128d sums[WEIGHTS_LANES / 2];
+  for (j = 0; j < WEIGHTS_LANES / 2; j++) {
+    sums[j] = _mm_setzero_pd();
+  }
+  for (i = 0; i + WEIGHTS_LANES <= nCities; i += WEIGHTS_LANES) {
+    for (j = 0; j < WEIGHTS_LANES / 2; j++) {
+      __m128d w = _mm_set_pd(choiceRow[cities[i + 2*j + 1]], choiceRow[cities[i + 2*j]]);
+      _mm_storeu_pd(&weights[i + 2*j], w);
+      sums[j] = _mm_add_pd(sums[j], w);
+    }
+  }
+  for (j = 0; j < WEIGHTS_LANES / 2; j++) {
+    _mm_storeu_pd(&lanes[2*j], sums[j]);
+  }
+  double total = sumWeightsLanes(lanes);
+  for (; i < nCities; i++) {
+    weights[i] = choiceRow[cities[i]];
+    total += weights[i];
+  }
+  return total;
+}
+
+__attribute__((target("avx2")))
+double computeWeightsAVX2(double* weights, double* choiceRow, int* cities, int nCities) {
+  int i;
+  double lanes[WEIGHTS_LANES];
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  __m256d sumLow = _mm256_setzero_pd();
+  __m256d sumHigh = _mm256_setzero_pd();
+  for (i = 0; i + WEIGHTS_LANES <= nCities; i += WEIGHTS_LANES) {
+    __m128i indexLow = _mm_loadu_si128((__m128i*) &cities[i]);
+    __m128i indexHigh = _mm_loadu_si128((__m128i*) &cities[i + 4]);
+    __m256d wLow = _mm256_mask_i32gather_pd(zero, choiceRow, indexLow, all, 8);
+    __m256d wHigh = _mm256_mask_i32gather_pd(zero, choiceRow, indexHigh, all, 8);
+    _mm256_storeu_pd(&weights[i], wLow);
+    _mm256_storeu_pd(&weights[i + 4], wHigh);
+    sumLow = _mm256_add_pd(sumLow, wLow);
+    sumHigh = _mm256_add_pd(sumHigh, wHigh);
+  }
+  _mm256_storeu_pd(&lanes[0], sumLow);
+  _mm256_storeu_pd(&lanes[4], sumHigh);
+  double total = sumWeightsLanes(lanes);
+  for (; i < nCities; i++) {
+    weights[i] = choiceRow[cities[i]];
+    total += weights[i];
+  }
+  return total;
+}
+
+__attribute__((target("avx512f")))
+double computeWeightsAVX512(double* weights, double* choiceRow, int* cities, int nCities) {
+  int i;
+  double lanes[WEIGHTS_LANES];
+  const __m512d zero = _mm512_setzero_pd();
+  __m512d sum = _mm512_setzero_pd();
+  for (i = 0; i + WEIGHTS_LANES <= nCities; i += WEIGHTS_LANES) {
+    __m256i index = _mm256_loadu_si256((__m256i*) &cities[i]);
+    __m512d w = _mm512_mask_i32gather_pd(zero, 0xFF, index, choiceRow, 8);
+    _mm512_storeu_pd(&weights[i], w);
+    sum = _mm512_add_pd(sum, w);
+  }
+  _mm512_storeu_pd(lanes, sum);
+  double total = sumWeightsLanes(lanes);
+  for (; i < nCities; i++) {
+    weights[i] = choiceRow[cities[i]];
+    total += weights[i];
+  }
+  return total;
+}
+#endif
+
+/**
+ * Select the best weights kernel supported by the CPU (done only once)
+ **/
+WeightsKernel getWeightsKernel() {
+  static WeightsKernel kernel = NULL;
+  if (kernel == NULL) {
+    kernel = computeWeightsScalar;
+#ifdef SIMD_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      kernel = computeWeightsAVX512;
+    } else if (__builtin_cpu_supports("avx2")) {
+      kernel = computeWeightsAVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      kernel = computeWeightsSSE2;
+    }
+#endif
+  }
+  return kernel;
+}
+
+/**
+ * Compute the weight (non normalized probability) to go in each city not
+ * visited yet from current city. weights[k] is the weight of the city
+ * unvisited[k]. Returns the total of the weights.
+ **/
+double computeWeights(int currentCity, double* weights, int* unvisited, int nUnvisited, double* choiceInfo, int nCities) {
+  int i;
+#ifdef SYMMETRIC_STORAGE
+  // Rows are not contiguous in packed storage
+  double total = 0;
+  for (i = 0; i < nUnvisited; i++) {
+    weights[i] = choiceInfo[getEdgeIndex(currentCity,unvisited[i],nCities)];
+    total += weights[i];
+  }
+#else
+  double* choiceRow = &choiceInfo[getEdgeIndex(currentCity,0,nCities)];
+  double total = getWeightsKernel()(weights, choiceRow, unvisited, nUnvisited);
+#endif
+
+  // If all the weights are really small
+  // We select one (not randomly to have always the same behavior)
+  if (total == 0) {
+    for (i = 0; i < nUnvisited; i++) {
+      weights[i] = 1.0;
+      total++;
+    }
+  }
+
+  return total;
+}
+
+/**
+ * Roulette wheel selection : returns the index of the weight in which the
+ * random number falls on the cumulative weights (with full precision).
+ * Small rows are scanned linearly, large rows use a binary search over the
+ * prefix sums of the weights, stored in cumulative.
+ * Only weights greater than 0 can be selected.
+ **/
+int selectRoulette(double* weights, double* cumulative, int nWeights, double total, long random) {
+  int i;
+  double target = ((double) (random % RANDOM_RANGE) / RANDOM_RANGE) * total;
+  double sum = 0;
+
+  if (nWeights <= ROULETTE_LINEAR_MAX) {
+    for (i = 0; i < nWeights; i++) {
+      sum += weights[i];
+      if (target < sum && weights[i] > 0) {
+        return i;
+      }
+    }
+  } else {
+    for (i = 0; i < nWeights; i++) {
+      sum += weights[i];
+      cumulative[i] = sum;
+    }
+    i = std::upper_bound(cumulative, cumulative + nWeights, target) - cumulative;
+    if (i < nWeights) {
+      return i;
+    }
+  }
+
+  // Rounding errors between total and the sum of the weights may leave the
+  // target after the last weight
+  for (i = nWeights - 1; i >= 0; i--) {
+    if (weights[i] > 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Given the current city, select the next city to go to (for an ant)
+ * Only the cities not visited yet (in the workspace) are scanned.
+ * If nearestNeighbours is not NULL, the choice is restricted to the unvisited
+ * cities of the candidate list of currentCity and all cities are only scanned
+ * when the whole candidate list is visited.
+ **/
+int computeNextCity(int currentCity, double* choiceInfo, int nCities, long random, int* nearestNeighbours, int nNeighbours, AntWorkspace* workspace) {
+  double total;
+  int index;
+
+  if (nearestNeighbours != NULL) {
+    int* candidates = &nearestNeighbours[getMatrixIndex(currentCity,0,nNeighbours)];
+    if (computeCandidateWeights(currentCity, workspace->weights, &total, candidates, nNeighbours, workspace->unvisitedIndex, choiceInfo, nCities)) {
+      return candidates[selectRoulette(workspace->weights, workspace->cumulative, nNeighbours, total, random)];
+    }
+  }
+
+  total = computeWeights(currentCity, workspace->weights, workspace->unvisited, workspace->nUnvisited, choiceInfo, nCities);
+  index = selectRoulette(workspace->weights, workspace->cumulative, workspace->nUnvisited, total, random);
+  if (index == -1) {
+    return -1;
+  }
+  return workspace->unvisited[index];
+}
+
+/**
+ * Compute the cost of the new path and returns the best cost between the current best and the one
+ * from the new path.
+ * The path contains the cities in visit order.
+ **/
+template <typename Distances>
+long computeCost(long bestCost, int* currentPath, Distances distance, int nCities) {
+  // compute currentCost
+  int i;
+  long currentCost = 0;
+
+  for (i = 0; i < nCities - 1; i++) {
+    currentCost += distance(currentPath[i], currentPath[i + 1]);
+  }
+  // add last
+  currentCost += distance(currentPath[nCities - 1], currentPath[0]);
+
+  if (bestCost > currentCost) {
+    return currentCost;
+  } else {
+    return bestCost;
+  }
+}
+
+long computeCost(long bestCost, int* currentPath, DistanceMatrix* map, int nCities) {
+  switch (map->type) {
+    case DISTANCE_COORDINATES:
+      return computeCost(bestCost, currentPath, getCoordinatesDistances(map), nCities);
+    case DISTANCE_UINT8:
+      return computeCost(bestCost, currentPath, getMatrixDistances<uint8_t>(map, nCities), nCities);
+    case DISTANCE_UINT16:
+      return computeCost(bestCost, currentPath, getMatrixDistances<uint16_t>(map, nCities), nCities);
+    default:
+      return computeCost(bestCost, currentPath, getMatrixDistances<uint32_t>(map, nCities), nCities);
+  }
+}
+
+/**
+ * Philox4x32-10 counter-based generator (Salmon et al., Random123) : returns
+ * in out 4 random words for a counter and a key
+ **/
+void philox4x32(const uint32_t counter[4], uint64_t key, uint32_t out[4]) {
+  uint32_t k0 = (uint32_t) key;
+  uint32_t k1 = (uint32_t) (key >> 32);
+  uint32_t c0 = counter[0];
+  uint32_t c1 = counter[1];
+  uint32_t c2 = counter[2];
+  uint32_t c3 = counter[3];
+  int round;
+  for (round = 0; round < 10; round++) {
+    uint64_t p0 = (uint64_t) 0xD2511F53 * c0;
+    uint64_t p1 = (uint64_t) 0xCD9E8D57 * c2;
+    c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t) p1;
+    c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t) p0;
+    k0 += 0x9E3779B9;
+    k1 += 0xBB67AE85;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/**
+ * Random numbers used by an ant to build its path
+ * They are read from the random numbers file, from numbers[counter] on.
+ * With COUNTER_RNG, the step-th number of an ant is generated by Philox keyed
+ * by the seed, for the counter (step, ant, iteration) : it does not depend on
+ * the number of ranks, and any number is computed without the previous ones.
+ **/
+struct AntRandom {
+  long* numbers;
+  long nNumbers;
+  long counter;
+  uint64_t seed;
+  uint32_t iteration;
+  uint32_t ant;
+  uint32_t block[4];
+};
+
+/**
+ * Start the random numbers of an ant : from randomNumbers[randomCounter] on,
+ * or (COUNTER_RNG) for the given global iteration and ant
+ **/
+void initAntRandom(AntRandom* random, long* randomNumbers, long nRandomNumbers, long randomCounter, uint64_t seed, long iteration, long ant) {
+  random->numbers = randomNumbers;
+  random->nNumbers = nRandomNumbers;
+  random->seed = seed;
+  random->iteration = (uint32_t) iteration;
+  random->ant = (uint32_t) ant;
+#ifdef COUNTER_RNG
+  random->counter = 0;
+#else
+  random->counter = randomCounter;
+#endif
+}
+
+/**
+ * Returns the next random number of an ant, in [0, RANDOM_RANGE]
+ **/
+long nextRandom(AntRandom* random) {
+#ifdef COUNTER_RNG
+  // one Philox block gives the numbers of 4 steps
+  if (random->counter % 4 == 0) {
+    uint32_t counter[4] = {(uint32_t) (random->counter / 4), random->ant, random->iteration, 0};
+    philox4x32(counter, random->seed, random->block);
+  }
+  long value = random->block[random->counter % 4] >> 1;
+  random->counter++;
+  return value;
+#else
+  long value = random->numbers[random->counter];
+  random->counter = (random->counter + 1) % random->nNumbers;
+  return value;
+#endif
+}
+
+/**
+ * Move the counter of the random numbers file by count numbers
+ * (nothing to do with COUNTER_RNG, where the numbers are not read from a file)
+ **/
+long advanceRandomCounter(long randomCounter, long count, long nRandomNumbers) {
+#ifdef COUNTER_RNG
+  return 0;
+#else
+  return (randomCounter + count) % nRandomNumbers;
+#endif
+}
+
+/**
+ * Build the path of an ant from a random start city.
+ * path receives the cities in visit order. One random number is used per
+ * city, taken from random.
+ * Returns the cost of the path, accumulated during the construction, or -1
+ * if a next city cannot be chosen.
+ **/
+template <typename Distances>
+long buildPath(int* path, Distances distance, double* choiceInfo, int nCities, AntRandom* random, int* nearestNeighbours, int nNeighbours, AntWorkspace* workspace) {
+  int i;
+  long cost = 0;
+
+  resetUnvisited(workspace, nCities);
+
+  // select a random start city for an ant
+  int currentCity = nextRandom(random) % nCities;
+  path[0] = currentCity;
+  removeUnvisited(workspace, currentCity);
+  for (i = 1; i < nCities; i++) {
+    // Find next city
+    int nextCity = computeNextCity(currentCity, choiceInfo, nCities, nextRandom(random), nearestNeighbours, nNeighbours, workspace);
+    if (nextCity == -1) {
+      return -1;
+    }
+
+    // add next city to plan
+    cost += distance(currentCity, nextCity);
+    path[i] = nextCity;
+    removeUnvisited(workspace, nextCity);
+    currentCity = nextCity;
+  }
+  // add last
+  cost += distance(currentCity, path[0]);
+
+  return cost;
+}
+
+long buildPath(int* path, DistanceMatrix* map, double* choiceInfo, int nCities, AntRandom* random, int* nearestNeighbours, int nNeighbours, AntWorkspace* workspace) {
+  switch (map->type) {
+    case DISTANCE_COORDINATES:
+      return buildPath(path, getCoordinatesDistances(map), choiceInfo, nCities, random, nearestNeighbours, nNeighbours, workspace);
+    case DISTANCE_UINT8:
+      return buildPath(path, getMatrixDistances<uint8_t>(map, nCities), choiceInfo, nCities, random, nearestNeighbours, nNeighbours, workspace);
+    case DISTANCE_UINT16:
+      return buildPath(path, getMatrixDistances<uint16_t>(map, nCities), choiceInfo, nCities, random, nearestNeighbours, nNeighbours, workspace);
+    default:
+      return buildPath(path, getMatrixDistances<uint32_t>(map, nCities), choiceInfo, nCities, random, nearestNeighbours, nNeighbours, workspace);
+  }
+}
+
+// Wall clock time (defined at the end of the file)
+double second();
+
+/**
+ * Build the paths of the nAnts ants of an iteration and keep the best one.
+ * With OpenMP, the ants are built in parallel, each thread with its own
+ * workspace. The ants are first split evenly between the deques of the
+ * threads, and a thread whose deque is empty steals from the others (see
+ * takeAnt), so that threads do not wait for the slowest one when the paths
+ * take different times to build. The ant k uses the random numbers from
+ * randomNumbers[randomCounter + k * nCities] on (with COUNTER_RNG, the ones
+ * of ant firstAnt + k of the iteration), and the best path is the one of
+ * lowest cost and then of lowest ant, so that the result is the one of the
+ * ants built one after the other, whatever the number of threads.
+ * bestPath is replaced by the best path if it is better than bestCost.
+ * Returns the new best cost, or -1 if a next city cannot be chosen.
+ **/
+long buildAntsPaths(DistanceMatrix* map, double* choiceInfo, int nCities, int nAnts, long* randomNumbers, long nRandomNumbers, long randomCounter, uint64_t seed, long iteration, long firstAnt, int* nearestNeighbours, int nNeighbours, AntWorkspace* workspaces, int* bestPath, long bestCost) {
+  int nThreads = getNumberOfThreads();
+  int error = 0;
+  int ant, t;
+
+  // the weights kernel is selected once, before the threads use it
+  getWeightsKernel();
+  for (t = 0; t < nThreads; t++) {
+    workspaces[t].bestCost = INFTY;
+    workspaces[t].bestAnt = -1;
+    workspaces[t].nextAnt = (int) ((long) nAnts * t / nThreads);
+    workspaces[t].endAnt = (int) ((long) nAnts * (t + 1) / nThreads);
+    workspaces[t].finishTime = 0.0;
+  }
+
+  double antsStart = second();
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nThreads) private(ant) reduction(|:error)
+#endif
+  {
+    AntWorkspace* workspace = &workspaces[getThreadNumber()];
+    while ((ant = takeAnt(workspaces, nThreads, getThreadNumber())) != -1) {
+      AntRandom random;
+      initAntRandom(&random, randomNumbers, nRandomNumbers, advanceRandomCounter(randomCounter, (long) ant * nCities, nRandomNumbers), seed, iteration, firstAnt + ant);
+      long cost = buildPath(workspace->path, map, choiceInfo, nCities, &random, nearestNeighbours, nNeighbours, workspace);
+      if (cost == -1) {
+        error = 1;
+      } else if (cost < workspace->bestCost || (cost == workspace->bestCost && ant < workspace->bestAnt)) {
+        int* path = workspace->bestPath;
+        workspace->bestPath = workspace->path;
+        workspace->path = path;
+        workspace->bestCost = cost;
+        workspace->bestAnt = ant;
+      }
+    }
+    workspace->finishTime = second();
+  }
+  double antsEnd = second();
+
+  // a thread not started (smaller team) has no finish time and waited all along
+  for (t = 0; t < nThreads; t++) {
+    if (workspaces[t].finishTime < antsStart) {
+      workspaces[t].finishTime = antsStart;
+    }
+    workspaces[t].busyTime += workspaces[t].finishTime - antsStart;
+    workspaces[t].waitTime += antsEnd - workspaces[t].finishTime;
+  }
+  if (error) {
+    return -1;
+  }
+
+  // best path of the threads
+  AntWorkspace* best = NULL;
+  for (t = 0; t < nThreads; t++) {
+    if (workspaces[t].bestAnt != -1 && (best == NULL || workspaces[t].bestCost < best->bestCost ||
+        (workspaces[t].bestCost == best->bestCost && workspaces[t].bestAnt < best->bestAnt))) {
+      best = &workspaces[t];
+    }
+  }
+  if (best != NULL && best->bestCost < bestCost) {
+    copyVectorInt(best->bestPath, bestPath, nCities);
+    return best->bestCost;
+  }
+  return bestCost;
+}
+
+/**
+ * Time spent by the threads building ants and waiting at the end of the
+ * iterations, and number of steals, summed over the threads
+ **/
+void sumSchedulerStats(AntWorkspace* workspaces, double* busyTime, double* waitTime, long* nSteals) {
+  int t;
+  *busyTime = 0.0;
+  *waitTime = 0.0;
+  *nSteals = 0;
+  for (t = 0; t < getNumberOfThreads(); t++) {
+    *busyTime += workspaces[t].busyTime;
+    *waitTime += workspaces[t].waitTime;
+    *nSteals += workspaces[t].nSteals;
+  }
+}
+
+/**
+ * Print on stderr the time spent by the threads building ants and waiting at
+ * the end of the iterations (summed over the threads), and the number of steals
+ **/
+void printSchedulerStats(int nThreads, double busyTime, double waitTime, long nSteals) {
+  double total = busyTime + waitTime;
+  fprintf(stderr, "Threads %d busy %f wait %f (%.1f%%) steals %ld\n", nThreads, busyTime, waitTime, total > 0.0 ? 100.0 * waitTime / total : 0.0, nSteals);
+}
+
+/**
+ * Apply the scale of the pheromons matrix to all its values (the scale becomes 1)
+ **/
+void normalizePheromons(double* pheromons, double* pheromonScale, int nCities) {
+  long j;
+  for (j = 0; j < getMatrixSize(nCities); j++) {
+    pheromons[j] *= *pheromonScale;
+  }
+  *pheromonScale = 1.0;
+}
+
+/**
+ * Pheromons evaporation
+ * The pheromons are stored with a global multiplicative scale : the pheromon
+ * of an edge is pheromonScale * pheromons[edge]. The evaporation only updates
+ * the scale, and the matrix is renormalized when the scale (or scale^beta used
+ * by the choice information) becomes too small.
+ * Returns 1 if the matrix was renormalized (the choice information has then
+ * to be updated), 0 otherwise.
+ **/
+int evaporatePheromons(double* pheromons, double* pheromonScale, double evaporationCoeff, int nCities, double beta) {
+  *pheromonScale *= evaporationCoeff;
+  if (*pheromonScale < PHEROMON_SCALE_MIN || pow(*pheromonScale, beta) < PHEROMON_SCALE_MIN) {
+    normalizePheromons(pheromons, pheromonScale, nCities);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Update the pheromons in the pheromons matrix given the current path
+ * (cities in visit order)
+ * The deposit is divided by the scale of the matrix.
+ *
+ * The maximum pheromon value for an edge is 1.
+ **/
+void updatePheromons(double* pheromons, double pheromonScale, int* orderedCities, long cost, int nCities) {
+  int i;
+  double deposit = 1.0 / (cost * pheromonScale);
+  double maximum = 1.0 / pheromonScale;
+
+  for (i = 0; i < nCities; i++) {
+    long j = getEdgeIndex(orderedCities[i], orderedCities[(i + 1) % nCities], nCities);
+    long k = getEdgeIndex(orderedCities[(i + 1) % nCities], orderedCities[i], nCities);
+    pheromons[j] += deposit;
+    if (k != j) {
+      pheromons[k] += deposit;
+    }
+    if (pheromons[j] > maximum) {
+      pheromons[j] = maximum;
+      pheromons[k] = maximum;
+    }
+  }
+}
+
+/**
+ * Add the pheromons of a path received from another node (cities in visit
+ * order, pheromonsPath[i] is the pheromon of the edge leaving path[i]) to the
+ * pheromons matrix, and count the number of values added to each edge in
+ * pheromonsUpdate (used to compute the average)
+ **/
+void mergePheromonsPath(double* pheromons, double* pheromonsUpdate, int* path, double* pheromonsPath, double pheromonScale, int nCities) {
+  int i;
+  for (i = 0; i < nCities; i++) {
+    long j = getEdgeIndex(path[i], path[(i + 1) % nCities], nCities);
+    long k = getEdgeIndex(path[(i + 1) % nCities], path[i], nCities);
+    pheromonsUpdate[j] += 1.0;
+    pheromons[j] += pheromonsPath[i] / pheromonScale;
+    if (k != j) {
+      pheromonsUpdate[k] += 1.0;
+      pheromons[k] += pheromonsPath[i] / pheromonScale;
+    }
+  }
+}
+
+#if __linux__ 
+
+#include <sys/time.h>
+
+double second() {
+  struct timeval tp;
+  struct timezone tzp;
+  gettimeofday(&tp,&tzp);
+  return ( (double) tp.tv_sec + (double) tp.tv_usec * 1.e-6 );
+}
+#elif _WIN32
+
+#define M_PI 3.14159265359
+
+double second() {
+  SYSTEMTIME st;
+  GetSystemTime(&st);
+  return ( (double)  st.wSecond + (double) st.wMilliseconds * 1.e-6 );
+}
+#endif
+
+#endif
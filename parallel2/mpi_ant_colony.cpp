@@ -7,6 +7,7 @@
  **/
 #include <mpi.h>
 #include "utils.h"
+#include "mpi_utils.h"
 
 int main(int argc, char* argv[]) {
 
@@ -19,36 +20,64 @@ int main(int argc, char* argv[]) {
 
   MPI_Status status;
 
+#ifdef _OPENMP
+  // Only the main thread calls MPI, the threads build the ants
+  int threadSupport;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
+#else
   MPI_Init(&argc, &argv);
+#endif
   MPI_Comm_rank(MPI_COMM_WORLD, &prank);
   MPI_Comm_size(MPI_COMM_WORLD, &psize);
 
+#ifdef _OPENMP
+  if (threadSupport < MPI_THREAD_FUNNELED && getNumberOfThreads() > 1) {
+    printf("Node %d : The MPI library does not support threads (MPI_THREAD_FUNNELED), set OMP_NUM_THREADS to 1\n", prank);
+    MPI_Finalize();
+    return -1;
+  }
+#endif
+
   if (prank == 0) {
     printf("NbOfNodes %d\n", psize);
   }
 
+  // Ranks of the same node share one copy of the read-only data
+  NodeCommunicators nodeComms;
+  if (createNodeCommunicators(&nodeComms)) {
+    printf("Node %d : Error in creation of node communicators", prank);
+    MPI_Finalize();
+    return -1;
+  }
+  MPI_Win randomNumbersWin;
+  MPI_Win mapWin;
+  MPI_Win heuristicWin;
+
   /**** VARIABLES DECLARATIONS ******/
-  int i, j, ant_counter, cities_counter;
+  int i;
   long loop_counter;
   long external_loop_counter = 0;
-  int* map = NULL;
+  DistanceMatrix map;
   double *pheromons;
   double* pheromonsUpdate;
-  // bestPath is a vector representing all cities in order.
-  // If the value is 0, the city was not visited
-  // else, the city is visited at step i
+  // bestPath is a vector representing all cities in visit order.
   int* bestPath;
   int* otherBestPath;
-  int* currentPath;
   long bestCost = INFTY;
-  long otherBestCost;
   double* localPheromonsPath;
-  double* otherPheromonsPath;
+  // exchanges of the values of the nodes in flight (see startExchange)
+  Exchange* exchanges;
+#if ISLAND_TOPOLOGY != ISLAND_NONE
+  // colony of this rank in the island model
+  Islands islands;
+#endif
 
   // To compare implementations, we need to have a fixed randomization.
   long* randomNumbers;
   long nRandomNumbers = 0;
   long random_counter = 0;
+  // seed of the random numbers generator (COUNTER_RNG)
+  uint64_t seed = 0;
 
   char* mapFile;
   char* randomFile;
@@ -66,70 +95,57 @@ int main(int argc, char* argv[]) {
 
   // termination condition
   long terminationCondition = 0;
-  // this variable is used to share its own current termiantion condition with others
-  long otherTerminationCondition = 0;
   double terminationConditionPercentage = 0.7;
 
   /*** LOAD AND SHARE RANDOM NUMBERS ***/
+  randomFile = argv[2];
   if (prank == 0) {
-    std::ifstream in;
-    randomFile = argv[2];
     printf("RandomFile %s\n", randomFile);
-    char out[20];
+  }
 
-    // Read random numbers file
-    in.open(randomFile);
+#ifdef COUNTER_RNG
+  // The random numbers are generated by each rank, the random file argument
+  // is the seed : nothing to read nor to share
+  seed = strtoull(randomFile, NULL, 10);
+  randomNumbers = NULL;
+  randomNumbersWin = MPI_WIN_NULL;
+#else
+  // Binary random numbers are read in parallel by the leaders of the nodes
+  int randomNumbersRead = readSharedRandomNumbers(randomFile, &randomNumbers, &nRandomNumbers, &nodeComms, &randomNumbersWin);
+  if (randomNumbersRead == -1) {
+    printf("Node %d : Error in reading of randomNumbers", prank);
+    MPI_Finalize();
+    return -1;
+  }
 
-    if (!in.is_open()) {
-      printf("Cannot open file.\n");
+  // Other files are loaded by rank 0 and broadcast
+  if (randomNumbersRead == 1) {
+    if (prank == 0 && LoadRandomNumbers(randomFile, &randomNumbers, &nRandomNumbers)) {
       printf("The filepath %s is incorrect\n", randomFile);
       MPI_Finalize();
       return -1;
     }
 
-    // Define number of random numbers
-    in >> out;
-    nRandomNumbers = atol(out);
-
-    // Allocation of random numbers vector
-    randomNumbers = (long*) malloc(nRandomNumbers*sizeof(long));
-
-    for (i = 0; i < nRandomNumbers; i++) {
-      randomNumbers[i] = 0;
+    // Share number of random numbers
+    if (MPI_Bcast(&nRandomNumbers, 1, MPI_LONG, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
+      printf("Node %d : Error in Broadcast of nRandomNumbers", prank);
+      MPI_Finalize();
+      return -1;
     }
 
-    i = 0;
-    while(!in.eof()) {
-      in >> out;
-      randomNumbers[i] = atol(out);
-      i++;
+    // Share all random numbers (one copy per node)
+    long* sharedRandomNumbers = (long*) shareFromRoot(randomNumbers, nRandomNumbers*sizeof(long), &nodeComms, &randomNumbersWin);
+    if (sharedRandomNumbers == NULL) {
+      printf("Node %d : Error in Broadcast of randomNumbers", prank);
+      MPI_Finalize();
+      return -1;
     }
-
-    in.close();
-
-  }
-
-  // Share number of random numbers
-  if (MPI_Bcast(&nRandomNumbers, 1, MPI_LONG, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
-    printf("Node %d : Error in Broadcast of nRandomNumbers", prank);
-    MPI_Finalize();
-    return -1;
-  }
-
-  if (prank != 0) {
-    // Allocation for random numbers on non-master nodes
-    randomNumbers = (long*) malloc(nRandomNumbers*sizeof(long));
-    for (i = 0; i < nRandomNumbers; i++) {
-      randomNumbers[i] = 0;
+    if (prank == 0) {
+      free(randomNumbers);
     }
+    randomNumbers = sharedRandomNumbers;
   }
-
-  // Share all random numbers
-  if (MPI_Bcast(&randomNumbers[0], nRandomNumbers, MPI_LONG, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
-    printf("Node %d : Error in Broadcast of randomNumbers", prank);
-    MPI_Finalize();
-    return -1;
-  }
+#endif
   /*************************************/
 
   /******** START TIMER ********/
@@ -141,7 +157,6 @@ int main(int argc, char* argv[]) {
 
   /*** READ ARGUMENTS AND DISTRIBUTE ANTS ***/
   if (prank == 0) {
-    mapFile = argv[1];
     totalNAnts = atoi(argv[3]);
     externalIterations = atoi(argv[4]);
     onNodeIteration = atoi(argv[5]);
@@ -151,38 +166,6 @@ int main(int argc, char* argv[]) {
 
     printf("Iterations %ld\n", externalIterations*onNodeIteration);
     printf("Ants %d\n", totalNAnts);
-
-    /*** LOAD MAP ***/
-    // Load the map and the number of cities
-    std::ifstream in;
-    in.open(mapFile);
-
-    if (!in.is_open()) {
-      printf("Cannot open file.\n");
-      printf("The filepath %s is incorrect\n", mapFile);
-      MPI_Finalize();
-      return -1;
-    }
-    char out[12];
-    in >> out;
-
-    // Define number of cities
-    nCities = atoi(out);
-
-    printf("Cities %d\n", nCities);
-
-    // Allocation of local map
-    map = (int*) malloc(nCities*nCities*sizeof(int));
-
-    in.close();
-
-    // Load the map inside map variable
-    if (LoadCities(mapFile, map)) {
-      printf("The filepath is incorrect\n");
-      MPI_Finalize();
-      return -1;
-    }
-    /****************/
   }
   /******************************************/
 
@@ -219,47 +202,97 @@ int main(int argc, char* argv[]) {
   }
 
 
-  // Share number of cities
-  if (MPI_Bcast(&nCities, 1, MPI_INT, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
-    printf("Node %d : Error in Broadcast of nCities", prank);
+  /*** LOAD AND SHARE MAP ***/
+  mapFile = argv[1];
+
+  // Binary maps are read in parallel by the leaders of the nodes
+  int mapRead = readSharedBinaryMap(mapFile, &map, &nCities, &nodeComms, &mapWin);
+  if (mapRead == -1) {
+    printf("Node %d : Error in reading of map", prank);
     MPI_Finalize();
     return -1;
   }
 
-  // Allocation of map for non-root nodes
-  if (prank != 0) {
-    map = (int*) malloc(nCities*nCities*sizeof(int));
-  }
+  // Other maps (TSPLIB or generate_map format) are loaded by rank 0 and broadcast
+  if (mapRead == 1) {
+    if (prank == 0 && LoadMap(mapFile, &map, &nCities)) {
+      printf("The filepath %s is incorrect\n", mapFile);
+      MPI_Finalize();
+      return -1;
+    }
 
+    // Share number of cities
+    if (MPI_Bcast(&nCities, 1, MPI_INT, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
+      printf("Node %d : Error in Broadcast of nCities", prank);
+      MPI_Finalize();
+      return -1;
+    }
 
-  if (MPI_Bcast(&map[0], nCities * nCities, MPI_INT, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
-    printf("Node %d : Error in Broadcast of map", prank);
-    MPI_Finalize();
-    return -1;
+    // Share the map (one copy per node)
+    if (shareMap(&map, nCities, &nodeComms, &mapWin)) {
+      printf("Node %d : Error in Broadcast of map", prank);
+      MPI_Finalize();
+      return -1;
+    }
+  }
+
+  if (prank == 0) {
+    printf("Cities %d\n", nCities);
   }
+  /*************************/
 
   /*** PHEROMONS AND PATHS ALLOCATION ***/
-  pheromons = (double*) malloc(nCities*nCities*sizeof(double));
-  pheromonsUpdate = (double*) malloc(nCities*nCities*sizeof(double));
+  pheromons = (double*) malloc(getMatrixSize(nCities)*sizeof(double));
+  // zero between the merges of the best paths (see mergeBestRecord)
+  pheromonsUpdate = (double*) calloc(getMatrixSize(nCities), sizeof(double));
   localPheromonsPath = (double*) malloc(nCities*sizeof(double));
 
   otherBestPath = (int*) malloc(nCities*sizeof(int));
-  otherPheromonsPath = (double*) malloc(nCities*sizeof(double));
+  exchanges = allocateExchanges(nCities, psize, 0);
+#if ISLAND_TOPOLOGY != ISLAND_NONE
+  if (createIslands(&islands, nCities)) {
+    printf("Node %d : Error in creation of the islands", prank);
+    MPI_Finalize();
+    return -1;
+  }
+#endif
   for (i = 0; i < nCities; i++) {
     otherBestPath[i] = -1;
   }
 
   bestPath = (int*) malloc(nCities*sizeof(int));
-  currentPath = (int*) malloc(nCities*sizeof(int));
 
   // Initialisation of pheromons and other vectors
   for (i = 0; i < nCities; i++) {
-    currentPath[i] = -1;
     bestPath[i] = -1;
   }
-  for (i = 0; i < nCities * nCities; i++) {
+  for (i = 0; i < getMatrixSize(nCities); i++) {
     pheromons[i] = 0.1;
   }
+
+  // Global scale of the pheromons matrix (see evaporatePheromons)
+  double pheromonScale = 1.0;
+
+  // Candidate lists of nearest neighbours (NULL if not used)
+  int nNeighbours = std::min(NN_LIST_SIZE, nCities - 1);
+  int* nearestNeighbours = NULL;
+  if (nNeighbours > 0) {
+    nearestNeighbours = computeNearestNeighbours(&map, nCities, nNeighbours);
+  }
+
+  // Choice information used to build paths (heuristic part is computed once per node)
+  Heuristic heuristic;
+  if (shareHeuristic(&heuristic, &map, nCities, alpha, &nodeComms, &heuristicWin)) {
+    printf("Node %d : Error in sharing of heuristic", prank);
+    MPI_Finalize();
+    return -1;
+  }
+  cacheNeighboursHeuristic(&heuristic, nearestNeighbours, nNeighbours);
+  double* choiceInfo = (double*) malloc(getMatrixSize(nCities)*sizeof(double));
+  updateChoiceInfo(choiceInfo, &heuristic, pheromons, nCities, beta);
+
+  // Scratch buffers of the ants (one per thread)
+  AntWorkspace* workspaces = allocateWorkspaces(nCities);
   /**************************************/
 
   int antsPerNode = totalNAnts / psize;
@@ -285,54 +318,27 @@ int main(int argc, char* argv[]) {
   }
 
   // Set the random counter to have right random values in each nodes
-  random_counter = (random_counter + (onNodeIteration * nAntsBeforeMe * nCities)) % nRandomNumbers;
+  random_counter = advanceRandomCounter(random_counter, onNodeIteration * nAntsBeforeMe * nCities, nRandomNumbers);
 
   long antsBestCost = INFTY;
 
-  while (external_loop_counter < externalIterations) { //&& terminationCondition < (long) ceilf(externalIterations * onNodeIteration * terminationConditionPercentage)) {
+  // The last EXCHANGE_LAG external iterations only merge the exchanges in flight
+  while (external_loop_counter < externalIterations + EXCHANGE_LAG) { //&& terminationCondition < (long) ceilf(externalIterations * onNodeIteration * terminationConditionPercentage)) {
 
     loop_counter = 0;
-    while (loop_counter < onNodeIteration) {
+    while (loop_counter < onNodeIteration && external_loop_counter < externalIterations) {
 
       // printf("Loop nr. : %ld in node %d, terminationCondition : %ld, bestCost : %ld\n", external_loop_counter, prank, terminationCondition,bestCost);
 
-      // Loop over each ant
-      for (ant_counter = 0; ant_counter < nAnts; ant_counter++) {
-        // init currentPath 
-        // -1 means not visited
-        for (i = 0; i < nCities; i++) {
-          currentPath[i] = -1;
-        }
-
-        // select a random start city for an ant
-        long rand = randomNumbers[random_counter];
-        int currentCity = rand % nCities;
-        random_counter = (random_counter + 1) % nRandomNumbers;
-        // currentPath will contain the order of visited cities
-        currentPath[currentCity] = 0;
-        for (cities_counter = 1; cities_counter < nCities; cities_counter++) {
-          // Find next city
-          rand = randomNumbers[random_counter];
-          random_counter = (random_counter + 1) % nRandomNumbers;
-          currentCity = computeNextCity(currentCity, currentPath, map, nCities, pheromons, alpha, beta, rand);
-
-          if (currentCity == -1) {
-            printf("There is an error choosing the next city in iteration %ld for ant %d on node %d\n", loop_counter, ant_counter, prank);
-            MPI_Finalize();
-            return -1;
-          }
-
-          // add next city to plan
-          currentPath[currentCity] = cities_counter;
-        }
-
-        // update bestCost and bestPath
-        long oldCost = bestCost;
-        bestCost = computeCost(bestCost, bestPath, currentPath, map, nCities);
+      // Build the paths of the ants (in parallel with OpenMP)
+      // and keep the best one
+      bestCost = buildAntsPaths(&map, choiceInfo, nCities, nAnts, randomNumbers, nRandomNumbers, random_counter, seed, external_loop_counter * onNodeIteration + loop_counter, nAntsBeforeMe, nearestNeighbours, nNeighbours, workspaces, bestPath, bestCost);
+      random_counter = advanceRandomCounter(random_counter, (long) nAnts * nCities, nRandomNumbers);
 
-        if (oldCost > bestCost) {
-          copyVectorInt(currentPath, bestPath, nCities);
-        }
+      if (bestCost == -1) {
+        printf("There is an error choosing the next city in iteration %ld on node %d\n", loop_counter, prank);
+        MPI_Finalize();
+        return -1;
       }
 
       if (bestCost < antsBestCost) {
@@ -342,106 +348,80 @@ int main(int argc, char* argv[]) {
         terminationCondition++;
       }
 
-      // Pheromon evaporation
-      for (j = 0; j < nCities * nCities; j++) {
-        pheromons[j] *= evaporationCoeff;
+      // Pheromon evaporation (only the scale of the matrix changes)
+      if (evaporatePheromons(pheromons, &pheromonScale, evaporationCoeff, nCities, beta)) {
+        updateChoiceInfo(choiceInfo, &heuristic, pheromons, nCities, beta);
+      }
+      // Update pheromons and the choice information of the edges of the best path
+      updatePheromons(pheromons, pheromonScale, bestPath, bestCost, nCities);
+      updateChoiceInfoPath(choiceInfo, &heuristic, pheromons, bestPath, nCities, beta);
+
+#if ISLAND_TOPOLOGY != ISLAND_NONE
+      // Merge the best path of the immigrants received from the neighbours
+      int nImmigrants = receiveImmigrants(&islands, nCities);
+      if (nImmigrants == -1) {
+        printf("Node %d : Error in reception of immigrants", prank);
+        MPI_Finalize();
+        return -1;
+      }
+      if (nImmigrants > 0) {
+        mergeBestRecord(islands.immigrants, nImmigrants, -1, pheromons, pheromonsUpdate, pheromonScale, localPheromonsPath, bestPath, &bestCost, &terminationCondition, nCities);
+        updateChoiceInfoPath(choiceInfo, &heuristic, pheromons, bestPath, nCities, beta);
       }
-      // Update pheromons
-      updatePheromons(pheromons, bestPath, bestCost, nCities);
 
-      loop_counter++;
-    }
+      // Push the best path to the neighbours
+      if ((external_loop_counter * onNodeIteration + loop_counter + 1) % MIGRATION_INTERVAL == 0) {
+        findPheromonsPath(localPheromonsPath, bestPath, pheromons, pheromonScale, nCities);
+        packPathRecord(islands.record, bestPath, localPheromonsPath, bestCost, terminationCondition, nCities);
+        if (migrate(&islands, nCities)) {
+          printf("Node %d : Error in migration of best path", prank);
+          MPI_Finalize();
+          return -1;
+        }
+      }
+#endif
 
-    // Find the pheromons values from best path just computed locally
-    findPheromonsPath(localPheromonsPath, bestPath, pheromons, nCities);
+      // Let the exchanges in flight progress
+      progressExchanges(exchanges);
 
-    // Set number of time a values will be added to each pheromon edge
-    // It is used to do an average and to not have paths that become really important quickly.
-    for (j = 0; j < nCities*nCities; j++) {
-      pheromonsUpdate[j] = 1.0;
+      loop_counter++;
     }
 
-    // Define temporary values
-    long tempBestCost = bestCost;
-    int* tempBestPath = (int*) malloc(nCities * sizeof(int));
-    double* tempPheromonsPath= (double*) malloc(nCities * sizeof(double));
-    long tempTerminationCondition = terminationCondition;
-    copyVectorInt(bestPath, tempBestPath, nCities);
-
-    // Each node will send to each other its values
-    for (i = 0; i < psize; i++) {
-      if (prank == i) {
-        // Set "other" values with my values
-        copyVectorInt(bestPath, otherBestPath, nCities);
-        copyVectordouble(localPheromonsPath, otherPheromonsPath, nCities);
-        copyVectordouble(localPheromonsPath, tempPheromonsPath, nCities);
-        otherTerminationCondition = terminationCondition;
-        otherBestCost = bestCost;
-      }
-      // Share values from node i
-      if (MPI_Bcast(&otherBestPath[0], nCities, MPI_INT, i, MPI_COMM_WORLD) != MPI_SUCCESS) {
-        printf("Node %d : Error in Broadcast of otherBestPath", prank);
-        MPI_Finalize();
-        return -1;
-      }
-      if (MPI_Bcast(&otherPheromonsPath[0], nCities, MPI_DOUBLE, i, MPI_COMM_WORLD) != MPI_SUCCESS) {
-        printf("Node %d : Error in Broadcast of otherPheromonsPath", prank);
-        MPI_Finalize();
-        return -1;
-      }
-      if (MPI_Bcast(&otherTerminationCondition, 1, MPI_LONG, i, MPI_COMM_WORLD) != MPI_SUCCESS) {
-        printf("Node %d : Error in Broadcast of otherTerminationCondition", prank);
+    // Start the exchange of the values of this block with the other nodes
+    // (the islands only exchange with their neighbours)
+    if (external_loop_counter < externalIterations && ISLAND_TOPOLOGY == ISLAND_NONE) {
+      // Find the pheromons values from best path just computed locally
+      findPheromonsPath(localPheromonsPath, bestPath, pheromons, pheromonScale, nCities);
+
+      Exchange* exchange = &exchanges[external_loop_counter % getNumberOfExchanges()];
+      packPathRecord(exchange->localRecord, bestPath, localPheromonsPath, bestCost, terminationCondition, nCities);
+      if (startExchange(exchange, NULL, nCities)) {
+        printf("Node %d : Error in Allgather of best paths", prank);
         MPI_Finalize();
         return -1;
       }
-      if (MPI_Bcast(&otherBestCost, 1, MPI_LONG, i, MPI_COMM_WORLD) != MPI_SUCCESS) {
-        printf("Node %d : Error in Broadcast of otherBestCost", prank);
+    }
+
+    // Merge the values exchanged EXCHANGE_LAG blocks before (this block without lag)
+    if (external_loop_counter >= EXCHANGE_LAG && ISLAND_TOPOLOGY == ISLAND_NONE) {
+      Exchange* exchange = &exchanges[(external_loop_counter - EXCHANGE_LAG) % getNumberOfExchanges()];
+      if (waitExchange(exchange)) {
+        printf("Node %d : Error in Allgather of best paths", prank);
         MPI_Finalize();
         return -1;
       }
 
-      // If i am not node i, I will check if values from node i are better than mine
-      if (prank != i) {
-        if (otherBestCost < tempBestCost) {
-          tempTerminationCondition = otherTerminationCondition;
-          tempBestCost = otherBestCost;
-          copyVectorInt(otherBestPath, tempBestPath,  nCities);
-          copyVectordouble(otherPheromonsPath, tempPheromonsPath, nCities);
-        } else if (otherBestCost == tempBestCost) {
-          // If the best cost is the same as mine, I simply update the termination condition counter
-          tempTerminationCondition += otherTerminationCondition;
-        }
-
-      }
+      // Merge the best path of the nodes (the current best path of this node
+      // with EXCHANGE_LAG) into the pheromons, and keep it as best path
+      mergeBestRecord(exchange->records, psize, prank, pheromons, pheromonsUpdate, pheromonScale, localPheromonsPath, bestPath, &bestCost, &terminationCondition, nCities);
+      updateChoiceInfoPath(choiceInfo, &heuristic, pheromons, bestPath, nCities, beta);
     }
 
-    // Update pheromons from best path received from other nodes
-    for (j = 0; j < nCities - 1; j++) {
-      pheromonsUpdate[getMatrixIndex(tempBestPath[j],tempBestPath[j+1],nCities)] += 1.0;
-      pheromonsUpdate[getMatrixIndex(tempBestPath[j+1],tempBestPath[j],nCities)] += 1.0;
-      pheromons[getMatrixIndex(tempBestPath[j],tempBestPath[j+1],nCities)] += tempPheromonsPath[j];
-      pheromons[getMatrixIndex(tempBestPath[j+1],tempBestPath[j],nCities)] += tempPheromonsPath[j];
-    }
-    pheromonsUpdate[getMatrixIndex(tempBestPath[nCities-1],tempBestPath[0],nCities)] += 1.0;
-    pheromonsUpdate[getMatrixIndex(tempBestPath[0],tempBestPath[nCities-1],nCities)] += 1.0;
-    pheromons[getMatrixIndex(tempBestPath[nCities-1],tempBestPath[0],nCities)] += tempPheromonsPath[nCities - 1];
-    pheromons[getMatrixIndex(tempBestPath[0],tempBestPath[nCities-1],nCities)] += tempPheromonsPath[nCities - 1];
-
-    // Compute the average for each pheromons value received
-    for (j = 0; j < nCities*nCities; j++) {
-      pheromons[j] = pheromons[j] / pheromonsUpdate[j];
-    }
-
-    // Set own variables with new best values
-    bestCost = tempBestCost;
-    copyVectorInt(tempBestPath, bestPath, nCities);
-    terminationCondition = tempTerminationCondition;
-
 
     external_loop_counter++;
 
     // Set the counter correctly for next random numbers on current node
-    random_counter = (random_counter + (onNodeIteration * (totalNAnts - nAnts) * nCities)) % nRandomNumbers;
+    random_counter = advanceRandomCounter(random_counter, onNodeIteration * (totalNAnts - nAnts) * nCities, nRandomNumbers);
   }
 
   // Merge solution into root 
@@ -453,7 +433,7 @@ int main(int argc, char* argv[]) {
         return -1;
       }
       long oldCost = bestCost;
-      bestCost = computeCost(bestCost, bestPath, otherBestPath, map, nCities);
+      bestCost = computeCost(bestCost, otherBestPath, &map, nCities);
 
       if (oldCost > bestCost) {
         copyVectorInt(otherBestPath, bestPath, nCities);
@@ -481,14 +461,33 @@ int main(int argc, char* argv[]) {
     /*****************/
   }
 
+#ifdef _OPENMP
+  // Time the threads waited for each other at the end of the iterations
+  if (reportSchedulerStats(workspaces)) {
+    printf("Node %d : Error in Reduce of scheduler statistics", prank);
+    MPI_Finalize();
+    return -1;
+  }
+#endif
+
   // deallocate the pointers
-  free(randomNumbers);
-  free(map);
+  freeNodeShared(randomNumbers, &randomNumbersWin);
+  freeNodeShared(getMapData(&map), &mapWin);
   free(pheromons);
   free(localPheromonsPath);
-  free(otherPheromonsPath);
+  freeExchanges(exchanges);
+#if ISLAND_TOPOLOGY != ISLAND_NONE
+  freeIslands(&islands);
+#endif
   free(bestPath);
   free(otherBestPath);
+  free(pheromonsUpdate);
+  freeNodeShared(heuristic.values, &heuristicWin);
+  free(heuristic.neighbourValues);
+  free(choiceInfo);
+  free(nearestNeighbours);
+  freeWorkspaces(workspaces);
+  freeNodeCommunicators(&nodeComms);
 
   MPI_Finalize();
 
@@ -0,0 +1,1535 @@
+/**
+ *
+ * Ant Colony Traveling Salesman Problem Optimization - MPI
+ * mpi_utils.h - help functions to share the data of the nodes
+ *
+ **/
+
+#ifndef MPI_UTILS_H
+#define MPI_UTILS_H
+
+#include <mpi.h>
+#include "utils.h"
+
+// Number of blocks of local iterations between the start of an exchange of
+// the nodes and the merge of the values received. 0 means that the exchange
+// is blocking. Otherwise, the nodes keep iterating while the values are
+// exchanged with non-blocking collectives (MPI-3), and merge them
+// EXCHANGE_LAG blocks later.
+#ifndef EXCHANGE_LAG
+#define EXCHANGE_LAG 0
+#endif
+
+#if EXCHANGE_LAG > 0 && MPI_VERSION < 3
+#error "EXCHANGE_LAG needs the non-blocking collectives of MPI-3"
+#endif
+
+// Exchange of the pheromons matrices of parallel3
+// PHEROMON_EXCHANGE_FULL : the whole matrices are summed (MPI_Allreduce)
+// PHEROMON_EXCHANGE_SPARSE : only the edges deposited since the last exchange
+// are sent (see PheromonDeltas)
+// PHEROMON_EXCHANGE_QUANTIZED : the whole matrices are averaged with
+// reduced precision values (see averageQuantizedPheromons)
+// PHEROMON_EXCHANGE_TOP_K : only the PHEROMON_TOP_K strongest edges of each
+// city are sent (see StrongestEdges)
+#define PHEROMON_EXCHANGE_FULL 0
+#define PHEROMON_EXCHANGE_SPARSE 1
+#define PHEROMON_EXCHANGE_QUANTIZED 2
+#define PHEROMON_EXCHANGE_TOP_K 3
+
+#ifndef PHEROMON_EXCHANGE
+#define PHEROMON_EXCHANGE PHEROMON_EXCHANGE_FULL
+#endif
+
+#if PHEROMON_EXCHANGE != PHEROMON_EXCHANGE_FULL && EXCHANGE_LAG > 0
+#error "EXCHANGE_LAG needs the full exchange of the pheromons (PHEROMON_EXCHANGE 0)"
+#endif
+
+// Format of the quantized pheromons (PHEROMON_EXCHANGE_QUANTIZED)
+// QUANTIZATION_BF16 : bfloat16 (8 bits of exponent, 7 of mantissa)
+// QUANTIZATION_FP16 : IEEE half precision (5 bits of exponent, 10 of mantissa)
+// QUANTIZATION_LOG8, QUANTIZATION_LOG16 : 8 or 16 bits fixed point value of
+// -log2(pheromon) over PHEROMON_LOG_RANGE binades
+#define QUANTIZATION_BF16 0
+#define QUANTIZATION_FP16 1
+#define QUANTIZATION_LOG8 2
+#define QUANTIZATION_LOG16 3
+
+#ifndef PHEROMON_QUANTIZATION
+#define PHEROMON_QUANTIZATION QUANTIZATION_BF16
+#endif
+
+#ifndef PHEROMON_LOG_RANGE
+#define PHEROMON_LOG_RANGE 32
+#endif
+
+// Maximal number of pheromons quantized and exchanged at once
+#define QUANTIZATION_CHUNK (1 << 22)
+
+// Number of edges sent per city (PHEROMON_EXCHANGE_TOP_K)
+#ifndef PHEROMON_TOP_K
+#define PHEROMON_TOP_K 8
+#endif
+
+// Island model (parallel2) : with ISLAND_TOPOLOGY, there is no global
+// exchange of the nodes. Each rank is a colony that pushes its best path to
+// its neighbours in the topology every MIGRATION_INTERVAL iterations, and
+// pulls the paths received from them (the immigrants) after each iteration.
+#define ISLAND_NONE 0
+#define ISLAND_RING 1
+#define ISLAND_TORUS 2
+#define ISLAND_HYPERCUBE 3
+
+#ifndef ISLAND_TOPOLOGY
+#define ISLAND_TOPOLOGY ISLAND_NONE
+#endif
+
+#ifndef MIGRATION_INTERVAL
+#define MIGRATION_INTERVAL 10
+#endif
+
+// Maximal number of neighbours of an island (hypercube of 2^31 ranks)
+#define ISLAND_MAX_NEIGHBOURS 32
+
+// Maximal number of bytes sent by one MPI_Bcast or MPI_Allreduce (their count is an int)
+#define MPI_BCAST_CHUNK (1 << 30)
+
+/**
+ * Communicators of the ranks running on the same node (node), and of the
+ * leaders of the nodes (leaders, MPI_COMM_NULL on the other ranks).
+ * The leader of a node is its rank 0, and rank 0 of MPI_COMM_WORLD is the
+ * leader of its node and the rank 0 of leaders.
+ * Without MPI-3, each rank is a node of its own.
+ **/
+struct NodeCommunicators {
+  MPI_Comm node;
+  MPI_Comm leaders;
+  int nodeRank;
+};
+
+int createNodeCommunicators(NodeCommunicators* nodeComms) {
+  int prank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &prank);
+#if MPI_VERSION >= 3
+  if (MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, prank, MPI_INFO_NULL, &nodeComms->node) != MPI_SUCCESS) {
+    return -1;
+  }
+#else
+  if (MPI_Comm_dup(MPI_COMM_SELF, &nodeComms->node) != MPI_SUCCESS) {
+    return -1;
+  }
+#endif
+  MPI_Comm_rank(nodeComms->node, &nodeComms->nodeRank);
+  if (MPI_Comm_split(MPI_COMM_WORLD, nodeComms->nodeRank == 0 ? 0 : MPI_UNDEFINED, prank, &nodeComms->leaders) != MPI_SUCCESS) {
+    return -1;
+  }
+  return 0;
+}
+
+void freeNodeCommunicators(NodeCommunicators* nodeComms) {
+  if (nodeComms->leaders != MPI_COMM_NULL) {
+    MPI_Comm_free(&nodeComms->leaders);
+  }
+  MPI_Comm_free(&nodeComms->node);
+}
+
+/**
+ * Broadcast of a buffer of any size, by chunks of MPI_BCAST_CHUNK bytes
+ **/
+int bcastBytes(void* data, MPI_Aint size, int root, MPI_Comm comm) {
+  MPI_Aint offset;
+  for (offset = 0; offset < size; offset += MPI_BCAST_CHUNK) {
+    int count = (int) std::min((MPI_Aint) MPI_BCAST_CHUNK, size - offset);
+    if (MPI_Bcast((char*) data + offset, count, MPI_BYTE, root, comm) != MPI_SUCCESS) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * In place sum over the ranks of a vector of doubles of any size, by chunks
+ * of MPI_BCAST_CHUNK bytes
+ **/
+int allreduceSum(double* data, long count, MPI_Comm comm) {
+  long offset;
+  long chunk = MPI_BCAST_CHUNK / sizeof(double);
+  for (offset = 0; offset < count; offset += chunk) {
+    int n = (int) std::min(chunk, count - offset);
+    if (MPI_Allreduce(MPI_IN_PLACE, data + offset, n, MPI_DOUBLE, MPI_SUM, comm) != MPI_SUCCESS) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Allocate size bytes shared by all the ranks of a node (allocated by the
+ * leader of the node). The memory has to be released with freeNodeShared.
+ * Returns the shared buffer, or NULL on error
+ **/
+void* allocateNodeShared(MPI_Aint size, NodeCommunicators* nodeComms, MPI_Win* win) {
+#if MPI_VERSION >= 3
+  void* data = NULL;
+  MPI_Aint sharedSize;
+  int dispUnit;
+  if (MPI_Win_allocate_shared(nodeComms->nodeRank == 0 ? size : 0, 1, MPI_INFO_NULL, nodeComms->node, &data, win) != MPI_SUCCESS) {
+    return NULL;
+  }
+  if (MPI_Win_shared_query(*win, 0, &sharedSize, &dispUnit, &data) != MPI_SUCCESS) {
+    return NULL;
+  }
+  return data;
+#else
+  *win = MPI_WIN_NULL;
+  return malloc(size);
+#endif
+}
+
+void freeNodeShared(void* data, MPI_Win* win) {
+  if (*win != MPI_WIN_NULL) {
+    MPI_Win_free(win);
+  } else {
+    free(data);
+  }
+}
+
+/**
+ * Wait for the leader of the node to have written the shared buffer
+ **/
+void syncNodeShared(MPI_Win win) {
+  if (win != MPI_WIN_NULL) {
+    MPI_Win_fence(0, win);
+  }
+}
+
+/**
+ * Allocate a buffer shared by the ranks of a node (see allocateNodeShared),
+ * and release it on all the ranks if one of them could not allocate it, so
+ * that the ranks do not wait for each other in the next collectives.
+ * Returns the shared buffer, or NULL on error (on all the ranks)
+ **/
+void* allocateAllNodeShared(MPI_Aint size, NodeCommunicators* nodeComms, MPI_Win* win) {
+  void* shared = allocateNodeShared(size, nodeComms, win);
+  int error = (shared == NULL && size > 0);
+  MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  if (error) {
+    if (shared != NULL) {
+      freeNodeShared(shared, win);
+    }
+    return NULL;
+  }
+  return shared;
+}
+
+/**
+ * Share a read-only buffer given by rank 0 with all the ranks : only the
+ * leaders of the nodes receive it, in a buffer shared by their node.
+ * data is only used on rank 0 (it stays owned by the caller).
+ * Returns the shared copy (to release with freeNodeShared), or NULL on error
+ * (on all the ranks)
+ **/
+void* shareFromRoot(void* data, MPI_Aint size, NodeCommunicators* nodeComms, MPI_Win* win) {
+  int prank;
+  int error = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &prank);
+  void* shared = allocateAllNodeShared(size, nodeComms, win);
+  if (shared == NULL && size > 0) {
+    return NULL;
+  }
+  if (prank == 0) {
+    memcpy(shared, data, size);
+  }
+  if (nodeComms->nodeRank == 0 && bcastBytes(shared, size, 0, nodeComms->leaders)) {
+    error = 1;
+  }
+  // the other ranks of the node wait in the fence whatever the leader got
+  syncNodeShared(*win);
+  MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  if (error) {
+    freeNodeShared(shared, win);
+    return NULL;
+  }
+  return shared;
+}
+
+/**
+ * Data of a map : its coordinates or its distances matrix
+ **/
+void* getMapData(DistanceMatrix* map) {
+  return (map->type == DISTANCE_COORDINATES) ? (void*) map->coordinates : map->distances;
+}
+
+/**
+ * Share the map loaded by rank 0 with all the ranks (one copy per node)
+ * The private map of rank 0 is released. The map has then to be released
+ * with freeNodeShared(getMapData(map), win) instead of freeDistances.
+ * Returns 0 if everything is fine
+ **/
+int shareMap(DistanceMatrix* map, int nCities, NodeCommunicators* nodeComms, MPI_Win* win) {
+  int prank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &prank);
+  if (MPI_Bcast(&map->type, 1, MPI_INT, 0, MPI_COMM_WORLD) != MPI_SUCCESS ||
+      MPI_Bcast(&map->metric, 1, MPI_INT, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
+    return -1;
+  }
+  MPI_Aint size = (map->type == DISTANCE_COORDINATES) ? 2 * nCities * sizeof(double) : getMatrixSize(nCities) * map->type;
+  void* shared = shareFromRoot(prank == 0 ? getMapData(map) : NULL, size, nodeComms, win);
+  if (shared == NULL) {
+    return -1;
+  }
+  if (prank == 0) {
+    freeDistances(map);
+  }
+  map->distances = NULL;
+  map->coordinates = NULL;
+  map->mapping = NULL;
+  map->mappingSize = 0;
+  if (map->type == DISTANCE_COORDINATES) {
+    map->coordinates = (double*) shared;
+  } else {
+    map->distances = shared;
+  }
+  return 0;
+}
+
+/**
+ * Read the header of a file on rank 0 and share it, with the size of the
+ * file, with all the ranks
+ * Returns 0 if the header has been read
+ **/
+int bcastFileHeader(char* file, void* header, int size, MPI_Offset* fileSize) {
+  int prank;
+  int error = 0;
+  long sizes[1] = {0};
+  MPI_Comm_rank(MPI_COMM_WORLD, &prank);
+  if (prank == 0) {
+    struct stat status;
+    FILE* in = fopen(file, "rb");
+    error = (in == NULL || fread(header, size, 1, in) != 1 || stat(file, &status) != 0);
+    if (in != NULL) {
+      fclose(in);
+    }
+    if (!error) {
+      sizes[0] = status.st_size;
+    }
+  }
+  if (MPI_Bcast(&error, 1, MPI_INT, 0, MPI_COMM_WORLD) != MPI_SUCCESS || error) {
+    return -1;
+  }
+  if (MPI_Bcast(header, size, MPI_BYTE, 0, MPI_COMM_WORLD) != MPI_SUCCESS ||
+      MPI_Bcast(sizes, 1, MPI_LONG, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
+    return -1;
+  }
+  *fileSize = sizes[0];
+  return 0;
+}
+
+/**
+ * Read size bytes of a file from offset into a buffer shared by each node,
+ * with MPI-IO : the leaders of the nodes each read a slice of the data with
+ * MPI_File_read_at_all, then the slices are gathered by all the leaders with
+ * a single MPI_Allgatherv. The slices are made of blocks of unit bytes so that
+ * the counts and displacements of MPI fit in an int, the remaining bytes (less
+ * than a block) are read by every leader.
+ * The checksum of the data is then checked by each leader.
+ * Returns the shared buffer (to release with freeNodeShared), or NULL on error
+ **/
+void* readSharedBinary(char* file, MPI_Offset offset, MPI_Aint size, uint64_t checksum, NodeCommunicators* nodeComms, MPI_Win* win) {
+  void* shared = allocateAllNodeShared(size, nodeComms, win);
+  int error = 0;
+  if (shared == NULL && size > 0) {
+    return NULL;
+  }
+
+  if (nodeComms->nodeRank == 0) {
+    int nLeaders, leaderRank, r;
+    MPI_File fileHandle;
+    MPI_Datatype unitType;
+    MPI_Comm_size(nodeComms->leaders, &nLeaders);
+    MPI_Comm_rank(nodeComms->leaders, &leaderRank);
+    MPI_Aint unit = 1;
+    while (size / unit > INT_MAX) {
+      unit *= 2;
+    }
+    MPI_Aint nUnits = size / unit;
+    MPI_Aint sliceUnits = (nUnits + nLeaders - 1) / nLeaders;
+    int* counts = (int*) malloc(nLeaders*sizeof(int));
+    int* displacements = (int*) malloc(nLeaders*sizeof(int));
+    for (r = 0; r < nLeaders; r++) {
+      MPI_Aint first = std::min(r * sliceUnits, nUnits);
+      displacements[r] = (int) first;
+      counts[r] = (int) (std::min(first + sliceUnits, nUnits) - first);
+    }
+    MPI_Aint sliceStart = displacements[leaderRank] * unit;
+    MPI_Aint sliceEnd = sliceStart + counts[leaderRank] * unit;
+
+    // Read my slice (by chunks, the count of MPI-IO is an int) and the tail
+    if (MPI_File_open(nodeComms->leaders, file, MPI_MODE_RDONLY, MPI_INFO_NULL, &fileHandle) != MPI_SUCCESS) {
+      error = 1;
+    } else {
+      // same number of rounds on every leader, the reads are collective
+      MPI_Aint rounds = (sliceUnits * unit + MPI_BCAST_CHUNK - 1) / MPI_BCAST_CHUNK;
+      for (r = 0; r < rounds; r++) {
+        MPI_Aint start = std::min(sliceStart + r * (MPI_Aint) MPI_BCAST_CHUNK, sliceEnd);
+        MPI_Aint end = std::min(start + (MPI_Aint) MPI_BCAST_CHUNK, sliceEnd);
+        if (MPI_File_read_at_all(fileHandle, offset + start, (char*) shared + start, (int) (end - start), MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+          error = 1;
+        }
+      }
+      if (MPI_File_read_at_all(fileHandle, offset + nUnits * unit, (char*) shared + nUnits * unit, (int) (size - nUnits * unit), MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+        error = 1;
+      }
+      MPI_File_close(&fileHandle);
+    }
+
+    // Gather the slices of all the leaders
+    MPI_Type_contiguous((int) unit, MPI_BYTE, &unitType);
+    MPI_Type_commit(&unitType);
+    if (MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, shared, counts, displacements, unitType, nodeComms->leaders) != MPI_SUCCESS) {
+      error = 1;
+    }
+    MPI_Type_free(&unitType);
+    free(counts);
+    free(displacements);
+
+    if (!error && computeChecksum((unsigned char*) shared, size) != checksum) {
+      error = 1;
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  if (error) {
+    if (shared != NULL) {
+      freeNodeShared(shared, win);
+    }
+    return NULL;
+  }
+  syncNodeShared(*win);
+  return shared;
+}
+
+/**
+ * Read a binary map file (see convert_map) in parallel into a buffer shared
+ * by each node (see readSharedBinary).
+ * The map has then to be released with freeNodeShared(getMapData(map), win).
+ * Returns 0 if the map has been read, 1 if the file is not a binary map
+ * stored like the distances matrix of this build (it has then to be loaded
+ * by rank 0 and shared with shareMap), -1 on error
+ **/
+int readSharedBinaryMap(char* file, DistanceMatrix* map, int* nCities, NodeCommunicators* nodeComms, MPI_Win* win) {
+  BinaryMapHeader header;
+  MPI_Offset fileSize;
+  int packed = 0;
+#ifdef SYMMETRIC_STORAGE
+  packed = 1;
+#endif
+  if (bcastFileHeader(file, &header, sizeof(BinaryMapHeader), &fileSize) ||
+      memcmp(header.magic, BINARY_MAP_MAGIC, 4) != 0 || header.version != BINARY_MAP_VERSION || header.nCities == 0 ||
+      (header.type != DISTANCE_COORDINATES && header.type != DISTANCE_UINT8 && header.type != DISTANCE_UINT16 && header.type != DISTANCE_UINT32) ||
+      (header.type != DISTANCE_COORDINATES && (int) header.symmetric != packed) ||
+      (size_t) fileSize != sizeof(BinaryMapHeader) + getBinaryMapDataSize(&header)) {
+    return 1;
+  }
+
+  void* shared = readSharedBinary(file, sizeof(BinaryMapHeader), getBinaryMapDataSize(&header), header.checksum, nodeComms, win);
+  if (shared == NULL) {
+    return -1;
+  }
+
+  *nCities = header.nCities;
+  map->type = header.type;
+  map->metric = header.metric;
+  map->distances = NULL;
+  map->coordinates = NULL;
+  map->mapping = NULL;
+  map->mappingSize = 0;
+  if (map->type == DISTANCE_COORDINATES) {
+    map->coordinates = (double*) shared;
+  } else {
+    map->distances = shared;
+  }
+  return 0;
+}
+
+/**
+ * Read a binary random numbers file in parallel into a buffer shared by each
+ * node (see readSharedBinary).
+ * randomNumbers has then to be released with freeNodeShared.
+ * Returns 0 if the random numbers have been read, 1 if the file is not a
+ * binary random numbers file (it has then to be loaded by rank 0), -1 on error
+ **/
+int readSharedRandomNumbers(char* file, long** randomNumbers, long* nRandomNumbers, NodeCommunicators* nodeComms, MPI_Win* win) {
+  BinaryRandomHeader header;
+  MPI_Offset fileSize;
+  if (sizeof(long) != sizeof(int64_t) ||
+      bcastFileHeader(file, &header, sizeof(BinaryRandomHeader), &fileSize) ||
+      memcmp(header.magic, BINARY_RANDOM_MAGIC, 4) != 0 || header.version != BINARY_RANDOM_VERSION ||
+      (uint64_t) fileSize != sizeof(BinaryRandomHeader) + header.nRandomNumbers * sizeof(int64_t)) {
+    return 1;
+  }
+
+  void* shared = readSharedBinary(file, sizeof(BinaryRandomHeader), header.nRandomNumbers * sizeof(int64_t), header.checksum, nodeComms, win);
+  if (shared == NULL) {
+    return -1;
+  }
+  *randomNumbers = (long*) shared;
+  *nRandomNumbers = header.nRandomNumbers;
+  return 0;
+}
+
+/**
+ * Compute the heuristic of the map once per node, by its leader directly in
+ * a buffer shared with the other ranks of the node. It has then to be
+ * released with freeNodeShared(heuristic->values, win) instead of
+ * freeHeuristic.
+ * Returns 0 if everything is fine
+ **/
+int shareHeuristic(Heuristic* heuristic, DistanceMatrix* map, int nCities, double alpha, NodeCommunicators* nodeComms, MPI_Win* win) {
+  // heuristic computed on the fly : nothing to share
+  if (map->type == DISTANCE_COORDINATES) {
+    computeHeuristic(heuristic, map, nCities, alpha);
+    *win = MPI_WIN_NULL;
+    return 0;
+  }
+  MPI_Aint size = getMatrixSize(nCities) * sizeof(double);
+  double* shared = (double*) allocateAllNodeShared(size, nodeComms, win);
+  if (shared == NULL && size > 0) {
+    return -1;
+  }
+  if (nodeComms->nodeRank == 0) {
+    computeHeuristicIn(heuristic, shared, map, nCities, alpha);
+  } else {
+    heuristic->values = shared;
+    heuristic->map = map;
+    heuristic->alpha = alpha;
+    heuristic->nCities = nCities;
+    heuristic->neighbourValues = NULL;
+    heuristic->neighbours = NULL;
+    heuristic->nNeighbours = 0;
+  }
+  syncNodeShared(*win);
+  return 0;
+}
+
+/**
+ * Best path of a rank shared with the others at the end of the external
+ * iterations, packed in one record so that it is exchanged with one
+ * collective : this header, the pheromons of the path (double[nCities],
+ * see findPheromonsPath) and the path (int[nCities]).
+ **/
+struct PathRecordHeader {
+  long cost;
+  long terminationCondition;
+};
+
+/**
+ * Size in bytes of a record (multiple of 8 to keep the records aligned)
+ **/
+int getPathRecordSize(int nCities) {
+  long size = sizeof(PathRecordHeader) + (long) nCities * (sizeof(double) + sizeof(int));
+  return (int) ((size + 7) / 8 * 8);
+}
+
+PathRecordHeader* getRecordHeader(char* record) {
+  return (PathRecordHeader*) record;
+}
+
+double* getRecordPheromonsPath(char* record) {
+  return (double*) (record + sizeof(PathRecordHeader));
+}
+
+int* getRecordPath(char* record, int nCities) {
+  return (int*) (getRecordPheromonsPath(record) + nCities);
+}
+
+/**
+ * pheromonsPath can be NULL when the other ranks do not use it (parallel3
+ * shares the whole pheromons matrix) : it is then filled with 0.
+ **/
+void packPathRecord(char* record, int* path, double* pheromonsPath, long cost, long terminationCondition, int nCities) {
+  getRecordHeader(record)->cost = cost;
+  getRecordHeader(record)->terminationCondition = terminationCondition;
+  if (pheromonsPath != NULL) {
+    copyVectordouble(pheromonsPath, getRecordPheromonsPath(record), nCities);
+  } else {
+    memset(getRecordPheromonsPath(record), 0, nCities * sizeof(double));
+  }
+  copyVectorInt(path, getRecordPath(record, nCities), nCities);
+}
+
+/**
+ * Share the record of each rank with all the others with one MPI_Allgather
+ * records receives the psize records in rank order (see getPathRecordSize)
+ * Returns 0 if everything is fine
+ **/
+int allgatherPathRecords(char* record, char* records, int nCities) {
+  int size = getPathRecordSize(nCities);
+  if (MPI_Allgather(record, size, MPI_BYTE, records, size, MPI_BYTE, MPI_COMM_WORLD) != MPI_SUCCESS) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Record of lowest cost among the nRecords records (the record skip is
+ * ignored, -1 for none), if it is lower than bestCost. bestCost and
+ * terminationCondition are then replaced by the ones of the record, and the
+ * termination conditions of the records of the same cost as bestCost are
+ * added to terminationCondition.
+ * Returns the best record, NULL if none is better than bestCost
+ **/
+char* findBestRecord(char* records, int nRecords, int skip, long* bestCost, long* terminationCondition, int nCities) {
+  char* best = NULL;
+  int i;
+  for (i = 0; i < nRecords; i++) {
+    char* record = records + (long) i * getPathRecordSize(nCities);
+    long otherBestCost = getRecordHeader(record)->cost;
+    long otherTerminationCondition = getRecordHeader(record)->terminationCondition;
+    if (i == skip) {
+      continue;
+    }
+    if (otherBestCost < *bestCost) {
+      *terminationCondition = otherTerminationCondition;
+      *bestCost = otherBestCost;
+      best = record;
+    } else if (otherBestCost == *bestCost) {
+      // If the best cost is the same, the termination condition counters are added
+      *terminationCondition += otherTerminationCondition;
+    }
+  }
+  return best;
+}
+
+/**
+ * Merge the best path among the one of the node and the ones of the records
+ * into the pheromons of the node (parallel2) : the pheromons of its edges are
+ * averaged with the ones of the node, which becomes the best path of the node
+ * (see findBestRecord for the arguments).
+ * Only the pheromons of the edges of the best path change, so only their
+ * choice information has to be updated (see updateChoiceInfoPath).
+ * localPheromonsPath is a buffer of nCities values. pheromonsUpdate is a
+ * matrix of zeros, and it is zero again when it returns.
+ **/
+void mergeBestRecord(char* records, int nRecords, int skip, double* pheromons, double* pheromonsUpdate, double pheromonScale, double* localPheromonsPath, int* bestPath, long* bestCost, long* terminationCondition, int nCities) {
+  int i;
+
+  char* best = findBestRecord(records, nRecords, skip, bestCost, terminationCondition, nCities);
+  if (best != NULL) {
+    copyVectorInt(getRecordPath(best, nCities), bestPath, nCities);
+    copyVectordouble(getRecordPheromonsPath(best), localPheromonsPath, nCities);
+  } else {
+    findPheromonsPath(localPheromonsPath, bestPath, pheromons, pheromonScale, nCities);
+  }
+
+  // Update pheromons from the best path and compute the average with the
+  // value of the node (pheromonsUpdate counts the values added to each edge)
+  // It is used to not have paths that become really important quickly.
+  mergePheromonsPath(pheromons, pheromonsUpdate, bestPath, localPheromonsPath, pheromonScale, nCities);
+  for (i = 0; i < nCities; i++) {
+    long j = getEdgeIndex(bestPath[i], bestPath[(i + 1) % nCities], nCities);
+    long k = getEdgeIndex(bestPath[(i + 1) % nCities], bestPath[i], nCities);
+    if (pheromonsUpdate[j] > 0) {
+      pheromons[j] = pheromons[j] / (1.0 + pheromonsUpdate[j]);
+      pheromonsUpdate[j] = 0.0;
+    }
+    if (pheromonsUpdate[k] > 0) {
+      pheromons[k] = pheromons[k] / (1.0 + pheromonsUpdate[k]);
+      pheromonsUpdate[k] = 0.0;
+    }
+  }
+}
+
+/**
+ * Exchange of the values of the nodes at the end of a block of local
+ * iterations : the records of the best paths (packed by the caller in
+ * localRecord) and, for parallel3, the sum of the pheromons matrices.
+ * With EXCHANGE_LAG, EXCHANGE_LAG + 1 exchanges can be in flight, and the
+ * pheromons matrix sent is a copy (pheromons) of the one of the node, which
+ * keeps changing, and the sum is received in pheromonsSum. Without it, the
+ * sum is reduced in place in the matrix of the node.
+ **/
+struct Exchange {
+  char* localRecord;
+  char* records;
+  double* pheromons;
+  double* pheromonsSum;
+  MPI_Request* requests;
+  int nRequests;
+};
+
+int getNumberOfExchanges() {
+  return EXCHANGE_LAG + 1;
+}
+
+/**
+ * Number of MPI_Allreduce needed to sum a matrix (see allreduceSum)
+ **/
+int getNumberOfReduceChunks(long count) {
+  long chunk = MPI_BCAST_CHUNK / sizeof(double);
+  return (int) ((count + chunk - 1) / chunk);
+}
+
+/**
+ * Allocate the getNumberOfExchanges() exchanges, with pheromons matrices if
+ * withPheromons (parallel3)
+ **/
+Exchange* allocateExchanges(int nCities, int psize, int withPheromons) {
+  int e;
+  Exchange* exchanges = (Exchange*) malloc(getNumberOfExchanges()*sizeof(Exchange));
+  for (e = 0; e < getNumberOfExchanges(); e++) {
+    exchanges[e].localRecord = (char*) malloc(getPathRecordSize(nCities));
+    exchanges[e].records = (char*) malloc((long) psize * getPathRecordSize(nCities));
+    exchanges[e].pheromons = NULL;
+    exchanges[e].pheromonsSum = NULL;
+    exchanges[e].nRequests = 1;
+    if (withPheromons) {
+#if EXCHANGE_LAG > 0
+      exchanges[e].pheromons = (double*) malloc(getMatrixSize(nCities)*sizeof(double));
+      exchanges[e].pheromonsSum = (double*) malloc(getMatrixSize(nCities)*sizeof(double));
+#endif
+      exchanges[e].nRequests += getNumberOfReduceChunks(getMatrixSize(nCities));
+    }
+    exchanges[e].requests = (MPI_Request*) malloc(exchanges[e].nRequests*sizeof(MPI_Request));
+    std::fill(exchanges[e].requests, exchanges[e].requests + exchanges[e].nRequests, MPI_REQUEST_NULL);
+  }
+  return exchanges;
+}
+
+void freeExchanges(Exchange* exchanges) {
+  int e;
+  for (e = 0; e < getNumberOfExchanges(); e++) {
+    free(exchanges[e].localRecord);
+    free(exchanges[e].records);
+    free(exchanges[e].pheromons);
+    free(exchanges[e].pheromonsSum);
+    free(exchanges[e].requests);
+  }
+  free(exchanges);
+}
+
+/**
+ * Start the exchange of the record packed in localRecord and, for parallel3,
+ * of the pheromons matrix of the node (NULL otherwise). Without
+ * EXCHANGE_LAG, the exchange is done when it returns.
+ * Returns 0 if everything is fine
+ **/
+int startExchange(Exchange* exchange, double* pheromons, int nCities) {
+#if EXCHANGE_LAG > 0
+  int size = getPathRecordSize(nCities);
+  int r = 1;
+  if (MPI_Iallgather(exchange->localRecord, size, MPI_BYTE, exchange->records, size, MPI_BYTE, MPI_COMM_WORLD, &exchange->requests[0]) != MPI_SUCCESS) {
+    return -1;
+  }
+  if (pheromons != NULL) {
+    long count = getMatrixSize(nCities);
+    long chunk = MPI_BCAST_CHUNK / sizeof(double);
+    long offset;
+    memcpy(exchange->pheromons, pheromons, count * sizeof(double));
+    for (offset = 0; offset < count; offset += chunk) {
+      int n = (int) std::min(chunk, count - offset);
+      if (MPI_Iallreduce(exchange->pheromons + offset, exchange->pheromonsSum + offset, n, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD, &exchange->requests[r++]) != MPI_SUCCESS) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+#else
+  if (allgatherPathRecords(exchange->localRecord, exchange->records, nCities)) {
+    return -1;
+  }
+  if (pheromons != NULL && allreduceSum(pheromons, getMatrixSize(nCities), MPI_COMM_WORLD)) {
+    return -1;
+  }
+  return 0;
+#endif
+}
+
+/**
+ * Let MPI progress the exchanges in flight while the node is iterating
+ **/
+void progressExchanges(Exchange* exchanges) {
+#if EXCHANGE_LAG > 0
+  int e, done;
+  for (e = 0; e < getNumberOfExchanges(); e++) {
+    MPI_Testall(exchanges[e].nRequests, exchanges[e].requests, &done, MPI_STATUSES_IGNORE);
+  }
+#endif
+}
+
+/**
+ * Wait for the end of an exchange
+ * Returns 0 if everything is fine
+ **/
+int waitExchange(Exchange* exchange) {
+  if (MPI_Waitall(exchange->nRequests, exchange->requests, MPI_STATUSES_IGNORE) != MPI_SUCCESS) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Average of the pheromons matrices of the psize nodes (parallel3)
+ * With EXCHANGE_LAG, the matrix of the node has changed since it was sent :
+ * its sent values are replaced by its current ones in the sum.
+ **/
+void averagePheromons(double* pheromons, Exchange* exchange, int nCities, int psize) {
+  long j;
+  for (j = 0; j < getMatrixSize(nCities); j++) {
+#if EXCHANGE_LAG > 0
+    pheromons[j] = (pheromons[j] + (exchange->pheromonsSum[j] - exchange->pheromons[j])) / psize;
+#else
+    pheromons[j] = pheromons[j] / psize;
+#endif
+  }
+}
+
+/**
+ * Pheromons deposited by a node since the last exchange of the pheromons
+ * (PHEROMON_EXCHANGE_SPARSE)
+ * The nodes start each block of iterations with the same pheromons matrix
+ * and scale, and the evaporation only changes the scale, in the same way on
+ * all the nodes. Only the values of the deposited edges differ : their
+ * stored value before their first deposit of the block (base) is kept, and
+ * the nodes only send the differences with it. The average of the matrices
+ * is then rebuilt by each node as base + sum of the differences / psize.
+ **/
+struct PheromonDelta {
+  long edge;
+  double base;
+  bool operator<(const PheromonDelta& other) const {
+    return edge < other.edge;
+  }
+};
+
+struct PheromonDeltas {
+  // 1 for the edges deposited since the last exchange
+  unsigned char* deposited;
+  PheromonDelta* deltas;
+  long nDeltas;
+  long capacity;
+  // message of the node (see exchangePheromonDeltas) and messages of all the nodes
+  char* message;
+  long messageCapacity;
+  char* messages;
+  long messagesCapacity;
+  int* sizes;
+  int* displacements;
+};
+
+void allocatePheromonDeltas(PheromonDeltas* deltas, int nCities, int psize) {
+  deltas->deposited = (unsigned char*) calloc(getMatrixSize(nCities), sizeof(unsigned char));
+  deltas->capacity = 2 * (long) nCities;
+  deltas->deltas = (PheromonDelta*) malloc(deltas->capacity*sizeof(PheromonDelta));
+  deltas->nDeltas = 0;
+  deltas->messageCapacity = 0;
+  deltas->message = NULL;
+  deltas->messagesCapacity = 0;
+  deltas->messages = NULL;
+  deltas->sizes = (int*) malloc(psize*sizeof(int));
+  deltas->displacements = (int*) malloc(psize*sizeof(int));
+}
+
+void freePheromonDeltas(PheromonDeltas* deltas) {
+  free(deltas->deposited);
+  free(deltas->deltas);
+  free(deltas->message);
+  free(deltas->messages);
+  free(deltas->sizes);
+  free(deltas->displacements);
+}
+
+void addPheromonDelta(PheromonDeltas* deltas, double* pheromons, long edge) {
+  if (deltas->deposited[edge]) {
+    return;
+  }
+  if (deltas->nDeltas == deltas->capacity) {
+    deltas->capacity *= 2;
+    deltas->deltas = (PheromonDelta*) realloc(deltas->deltas, deltas->capacity*sizeof(PheromonDelta));
+  }
+  deltas->deposited[edge] = 1;
+  deltas->deltas[deltas->nDeltas].edge = edge;
+  deltas->deltas[deltas->nDeltas].base = pheromons[edge];
+  deltas->nDeltas++;
+}
+
+/**
+ * Keep the base of the edges of a path (cities in visit order) before the
+ * pheromons are deposited on them (see updatePheromons)
+ **/
+void addPheromonDeltasPath(PheromonDeltas* deltas, double* pheromons, int* path, int nCities) {
+  int i;
+  for (i = 0; i < nCities; i++) {
+    addPheromonDelta(deltas, pheromons, getEdgeIndex(path[i], path[(i + 1) % nCities], nCities));
+    addPheromonDelta(deltas, pheromons, getEdgeIndex(path[(i + 1) % nCities], path[i], nCities));
+  }
+}
+
+/**
+ * The pheromons matrix was renormalized with this scale (see evaporatePheromons)
+ **/
+void rescalePheromonDeltas(PheromonDeltas* deltas, double scale) {
+  long d;
+  for (d = 0; d < deltas->nDeltas; d++) {
+    deltas->deltas[d].base *= scale;
+  }
+}
+
+/**
+ * Variable length encoding of a positive integer : 7 bits per byte, the
+ * high bit is set on all the bytes but the last one
+ * Returns the new position in the buffer
+ **/
+char* writeVarint(char* buffer, unsigned long value) {
+  while (value >= 0x80) {
+    *buffer++ = (char) ((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  *buffer++ = (char) value;
+  return buffer;
+}
+
+char* readVarint(char* buffer, unsigned long* value) {
+  int shift = 0;
+  *value = 0;
+  while (*buffer & 0x80) {
+    *value |= (unsigned long) (*buffer++ & 0x7f) << shift;
+    shift += 7;
+  }
+  *value |= (unsigned long) (unsigned char) *buffer++ << shift;
+  return buffer;
+}
+
+/**
+ * Decode a message of a node (see exchangePheromonDeltas) and add the
+ * differences / psize to the pheromons, or only update the choice
+ * information of the edges if choiceInfo is not NULL
+ **/
+void readPheromonDeltas(char* message, double* pheromons, int psize, double* choiceInfo, Heuristic* heuristic, int nCities, double beta) {
+  long nDeltas, d;
+  long edge = 0;
+  memcpy(&nDeltas, message, sizeof(long));
+  message += sizeof(long);
+  for (d = 0; d < nDeltas; d++) {
+    unsigned long gap;
+    double difference;
+    message = readVarint(message, &gap);
+    edge += (long) gap;
+    memcpy(&difference, message, sizeof(double));
+    message += sizeof(double);
+    if (choiceInfo != NULL) {
+      updateChoiceInfoEdge(choiceInfo, heuristic, pheromons, edge, nCities, beta);
+    } else {
+      pheromons[edge] += difference / psize;
+    }
+  }
+}
+
+/**
+ * Gather the messages of all the nodes, of any size, in messages (in rank
+ * order, the message of rank i starts at displacements[i] and its size is
+ * sizes[i]). messages is reallocated when it is smaller than their total size.
+ * Returns 0 if everything is fine
+ **/
+int allgatherMessages(char* message, long size, char** messages, long* messagesCapacity, int* sizes, int* displacements, int psize) {
+  long total = 0;
+  int i;
+  if (size > INT_MAX) {
+    return -1;
+  }
+
+  int messageSize = (int) size;
+  if (MPI_Allgather(&messageSize, 1, MPI_INT, sizes, 1, MPI_INT, MPI_COMM_WORLD) != MPI_SUCCESS) {
+    return -1;
+  }
+  for (i = 0; i < psize; i++) {
+    if (total + sizes[i] > INT_MAX) {
+      return -1;
+    }
+    displacements[i] = (int) total;
+    total += sizes[i];
+  }
+  if (total > *messagesCapacity) {
+    *messagesCapacity = total;
+    *messages = (char*) realloc(*messages, total);
+  }
+  if (MPI_Allgatherv(message, messageSize, MPI_BYTE, *messages, sizes, displacements, MPI_BYTE, MPI_COMM_WORLD) != MPI_SUCCESS) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Send the differences of the deposited edges with their base to the other
+ * nodes and receive theirs : the number of edges, then for each edge by
+ * increasing index, the gap with the previous index (varint) and the
+ * difference (double).
+ * Returns 0 if everything is fine
+ **/
+int exchangePheromonDeltas(PheromonDeltas* deltas, double* pheromons, int psize) {
+  long d, size;
+  long previous = 0;
+
+  std::sort(deltas->deltas, deltas->deltas + deltas->nDeltas);
+  size = sizeof(long) + deltas->nDeltas * (10 + sizeof(double));
+  if (size > deltas->messageCapacity) {
+    deltas->messageCapacity = size;
+    deltas->message = (char*) realloc(deltas->message, size);
+  }
+  char* position = deltas->message;
+  memcpy(position, &deltas->nDeltas, sizeof(long));
+  position += sizeof(long);
+  for (d = 0; d < deltas->nDeltas; d++) {
+    long edge = deltas->deltas[d].edge;
+    double difference = pheromons[edge] - deltas->deltas[d].base;
+    position = writeVarint(position, (unsigned long) (edge - previous));
+    memcpy(position, &difference, sizeof(double));
+    position += sizeof(double);
+    previous = edge;
+  }
+  return allgatherMessages(deltas->message, position - deltas->message, &deltas->messages, &deltas->messagesCapacity, deltas->sizes, deltas->displacements, psize);
+}
+
+/**
+ * Rebuild the average of the pheromons matrices of the nodes from the
+ * messages received (see exchangePheromonDeltas), update the choice
+ * information of the edges deposited by a node, and start a new block
+ **/
+void applyPheromonDeltas(PheromonDeltas* deltas, double* pheromons, double* choiceInfo, Heuristic* heuristic, int nCities, double beta, int psize) {
+  long d;
+  int i;
+  for (d = 0; d < deltas->nDeltas; d++) {
+    pheromons[deltas->deltas[d].edge] = deltas->deltas[d].base;
+    deltas->deposited[deltas->deltas[d].edge] = 0;
+  }
+  deltas->nDeltas = 0;
+  // the differences are added in the same order on all the nodes, which
+  // keep the same matrix
+  for (i = 0; i < psize; i++) {
+    readPheromonDeltas(deltas->messages + deltas->displacements[i], pheromons, psize, NULL, heuristic, nCities, beta);
+  }
+  for (i = 0; i < psize; i++) {
+    readPheromonDeltas(deltas->messages + deltas->displacements[i], pheromons, psize, choiceInfo, heuristic, nCities, beta);
+  }
+}
+
+/**
+ * Quantized pheromons (PHEROMON_EXCHANGE_QUANTIZED)
+ * The pheromons of a normalized matrix are in ]0, 1], and they are rounded
+ * to the nearest value of PHEROMON_QUANTIZATION. A pheromon is never
+ * quantized to 0 : the smallest ones are rounded to the smallest positive
+ * value, so that no edge becomes impossible to choose.
+ **/
+#if PHEROMON_QUANTIZATION == QUANTIZATION_LOG8
+typedef uint8_t PheromonCode;
+#else
+typedef uint16_t PheromonCode;
+#endif
+
+PheromonCode quantizePheromon(double pheromon) {
+#if PHEROMON_QUANTIZATION == QUANTIZATION_BF16
+  // upper half of the float, rounded to nearest even
+  float value = (float) pheromon;
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(float));
+  bits += 0x7FFF + ((bits >> 16) & 1);
+  return (PheromonCode) std::max(bits >> 16, (uint32_t) 1);
+#elif PHEROMON_QUANTIZATION == QUANTIZATION_FP16
+  int exponent;
+  long code;
+  // pheromon = mantissa * 2^exponent with mantissa in [0.5, 1[
+  double mantissa = frexp(pheromon, &exponent);
+  if (exponent < -13) {
+    // subnormal : multiple of 2^-24
+    code = (long) floor(ldexp(pheromon, 24) + 0.5);
+  } else {
+    // a mantissa rounded up to 1024 carries into the exponent
+    code = ((long) (exponent + 14) << 10) + (long) floor((2 * mantissa - 1) * 1024 + 0.5);
+  }
+  return (PheromonCode) std::max(code, 1L);
+#else
+  double levels = (double) std::numeric_limits<PheromonCode>::max();
+  double code = floor(-log(pheromon) / M_LN2 * levels / PHEROMON_LOG_RANGE + 0.5);
+  return (PheromonCode) std::min(std::max(code, 0.0), levels);
+#endif
+}
+
+double dequantizePheromon(PheromonCode code) {
+#if PHEROMON_QUANTIZATION == QUANTIZATION_BF16
+  uint32_t bits = (uint32_t) code << 16;
+  float value;
+  memcpy(&value, &bits, sizeof(float));
+  return value;
+#elif PHEROMON_QUANTIZATION == QUANTIZATION_FP16
+  int exponent = code >> 10;
+  int mantissa = code & 1023;
+  if (exponent == 0) {
+    return ldexp((double) mantissa, -24);
+  }
+  return ldexp((double) (1024 + mantissa), exponent - 25);
+#else
+  double levels = (double) std::numeric_limits<PheromonCode>::max();
+  return pow(2.0, -code * PHEROMON_LOG_RANGE / levels);
+#endif
+}
+
+/**
+ * Buffers of the quantized average of the pheromons matrices (see
+ * averageQuantizedPheromons)
+ **/
+struct QuantizedPheromons {
+  // chunk of the matrix of the node split in one block per rank, then the
+  // averages of the blocks of all the ranks
+  PheromonCode* codes;
+  // block of this rank quantized by all the ranks
+  PheromonCode* received;
+  // average of the block of this rank
+  PheromonCode* average;
+};
+
+/**
+ * Number of pheromons of the block of a rank in a chunk of n pheromons
+ **/
+long getQuantizedBlockSize(long n, int psize) {
+  return (n + psize - 1) / psize;
+}
+
+void allocateQuantizedPheromons(QuantizedPheromons* quantized, int nCities, int psize) {
+  long block = getQuantizedBlockSize(std::min(getMatrixSize(nCities), (long) QUANTIZATION_CHUNK), psize);
+  quantized->codes = (PheromonCode*) malloc(block * psize * sizeof(PheromonCode));
+  quantized->received = (PheromonCode*) malloc(block * psize * sizeof(PheromonCode));
+  quantized->average = (PheromonCode*) malloc(block * sizeof(PheromonCode));
+}
+
+void freeQuantizedPheromons(QuantizedPheromons* quantized) {
+  free(quantized->codes);
+  free(quantized->received);
+  free(quantized->average);
+}
+
+/**
+ * Average of the pheromons matrices of the psize nodes with quantized
+ * pheromons, by chunks of QUANTIZATION_CHUNK pheromons. MPI cannot sum
+ * quantized values, so it is done like a reduce-scatter followed by an
+ * allgather : each rank receives its block of the chunk quantized by all the
+ * ranks (MPI_Alltoall), sums them in rank order and quantizes their average,
+ * and the averages of all the blocks are gathered (MPI_Allgather). Each
+ * pheromon is sent twice, as by MPI_Allreduce, but with 1 or 2 bytes instead
+ * of 8. All the nodes keep the same (dequantized) matrix.
+ * Returns 0 if everything is fine
+ **/
+int averageQuantizedPheromons(QuantizedPheromons* quantized, double* pheromons, int nCities, int psize) {
+  long count = getMatrixSize(nCities);
+  long offset, j;
+  int i;
+  for (offset = 0; offset < count; offset += QUANTIZATION_CHUNK) {
+    long n = std::min((long) QUANTIZATION_CHUNK, count - offset);
+    long block = getQuantizedBlockSize(n, psize);
+    int size = (int) (block * sizeof(PheromonCode));
+    for (j = 0; j < block * psize; j++) {
+      // the last block is padded
+      quantized->codes[j] = j < n ? quantizePheromon(pheromons[offset + j]) : 0;
+    }
+    if (MPI_Alltoall(quantized->codes, size, MPI_BYTE, quantized->received, size, MPI_BYTE, MPI_COMM_WORLD) != MPI_SUCCESS) {
+      return -1;
+    }
+    for (j = 0; j < block; j++) {
+      double sum = 0;
+      for (i = 0; i < psize; i++) {
+        sum += dequantizePheromon(quantized->received[i * block + j]);
+      }
+      quantized->average[j] = quantizePheromon(sum / psize);
+    }
+    if (MPI_Allgather(quantized->average, size, MPI_BYTE, quantized->codes, size, MPI_BYTE, MPI_COMM_WORLD) != MPI_SUCCESS) {
+      return -1;
+    }
+    for (j = 0; j < n; j++) {
+      pheromons[offset + j] = dequantizePheromon(quantized->codes[j]);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Strongest edges of the pheromons matrices (PHEROMON_EXCHANGE_TOP_K)
+ * Each node sends the PHEROMON_TOP_K edges with the most pheromons of each
+ * city, i.e. O(n * k) values instead of the O(n^2) of the whole matrix, and
+ * merges the edges received from the other nodes with the averaging rule of
+ * the best paths of parallel2 (see mergePheromonsPath) : the pheromon of an
+ * edge becomes the average of its own value and of the values received.
+ * The pheromons matrix is symmetric (see updatePheromons), so an edge is sent
+ * once as (i,j) with i < j and merged in both directions.
+ **/
+struct PheromonEdge {
+  long edge;
+  double pheromon;
+  bool operator<(const PheromonEdge& other) const {
+    return edge < other.edge;
+  }
+};
+
+/**
+ * Order edges by decreasing pheromon (ties are broken by index)
+ **/
+struct StrongerPheromonEdge {
+  bool operator()(const PheromonEdge& a, const PheromonEdge& b) const {
+    if (a.pheromon != b.pheromon) {
+      return a.pheromon > b.pheromon;
+    }
+    return a.edge < b.edge;
+  }
+};
+
+struct StrongestEdges {
+  // edges of a city
+  PheromonEdge* row;
+  // strongest edges of all the cities
+  PheromonEdge* edges;
+  long nEdges;
+  // message of the node (see exchangeStrongestEdges) and messages of all the nodes
+  char* message;
+  char* messages;
+  long messagesCapacity;
+  int* sizes;
+  int* displacements;
+  // number of values received for each edge
+  int* nReceived;
+};
+
+/**
+ * Number of edges sent per city
+ **/
+int getTopK(int nCities) {
+  return std::min(PHEROMON_TOP_K, nCities - 1);
+}
+
+void allocateStrongestEdges(StrongestEdges* strongest, int nCities, int psize) {
+  long maxEdges = (long) nCities * getTopK(nCities);
+  strongest->row = (PheromonEdge*) malloc(nCities*sizeof(PheromonEdge));
+  strongest->edges = (PheromonEdge*) malloc(maxEdges*sizeof(PheromonEdge));
+  strongest->nEdges = 0;
+  strongest->message = (char*) malloc(sizeof(long) + maxEdges * (10 + sizeof(double)));
+  strongest->messages = NULL;
+  strongest->messagesCapacity = 0;
+  strongest->sizes = (int*) malloc(psize*sizeof(int));
+  strongest->displacements = (int*) malloc(psize*sizeof(int));
+  strongest->nReceived = (int*) calloc(getMatrixSize(nCities), sizeof(int));
+}
+
+void freeStrongestEdges(StrongestEdges* strongest) {
+  free(strongest->row);
+  free(strongest->edges);
+  free(strongest->message);
+  free(strongest->messages);
+  free(strongest->sizes);
+  free(strongest->displacements);
+  free(strongest->nReceived);
+}
+
+/**
+ * Select the getTopK() strongest edges of each city, sorted by index
+ **/
+void findStrongestEdges(StrongestEdges* strongest, double* pheromons, int nCities) {
+  int i, j, n;
+  int k = getTopK(nCities);
+  strongest->nEdges = 0;
+  if (k <= 0) {
+    return;
+  }
+  for (i = 0; i < nCities; i++) {
+    n = 0;
+    for (j = 0; j < nCities; j++) {
+      if (j != i) {
+        strongest->row[n].edge = getEdgeIndex(std::min(i, j), std::max(i, j), nCities);
+        strongest->row[n].pheromon = pheromons[strongest->row[n].edge];
+        n++;
+      }
+    }
+    std::nth_element(strongest->row, strongest->row + k - 1, strongest->row + n, StrongerPheromonEdge());
+    std::copy(strongest->row, strongest->row + k, strongest->edges + strongest->nEdges);
+    strongest->nEdges += k;
+  }
+  std::sort(strongest->edges, strongest->edges + strongest->nEdges);
+}
+
+/**
+ * Send the strongest edges of the node to the other nodes and receive theirs :
+ * the number of edges, then for each edge by increasing index, the gap with
+ * the previous index (varint) and the pheromon (double, with the scale of the
+ * matrix applied). An edge strong for both of its cities is sent once.
+ * Returns 0 if everything is fine
+ **/
+int exchangeStrongestEdges(StrongestEdges* strongest, double* pheromons, double pheromonScale, int nCities, int psize) {
+  long d;
+  long nEdges = 0;
+  long previous = 0;
+
+  findStrongestEdges(strongest, pheromons, nCities);
+  char* position = strongest->message + sizeof(long);
+  for (d = 0; d < strongest->nEdges; d++) {
+    long edge = strongest->edges[d].edge;
+    if (nEdges > 0 && edge == previous) {
+      continue;
+    }
+    double pheromon = strongest->edges[d].pheromon * pheromonScale;
+    position = writeVarint(position, (unsigned long) (edge - previous));
+    memcpy(position, &pheromon, sizeof(double));
+    position += sizeof(double);
+    previous = edge;
+    nEdges++;
+  }
+  memcpy(strongest->message, &nEdges, sizeof(long));
+  return allgatherMessages(strongest->message, position - strongest->message, &strongest->messages, &strongest->messagesCapacity, strongest->sizes, strongest->displacements, psize);
+}
+
+/**
+ * Decode a message of a node (see exchangeStrongestEdges) and add its
+ * pheromons to the edges, or, if choiceInfo is not NULL, compute the average
+ * of the edges (in both directions) and update their choice information
+ **/
+void readStrongestEdges(char* message, int* nReceived, double* pheromons, double pheromonScale, double* choiceInfo, Heuristic* heuristic, int nCities, double beta) {
+  long nEdges, d;
+  long edge = 0;
+  memcpy(&nEdges, message, sizeof(long));
+  message += sizeof(long);
+  for (d = 0; d < nEdges; d++) {
+    unsigned long gap;
+    double pheromon;
+    message = readVarint(message, &gap);
+    edge += (long) gap;
+    memcpy(&pheromon, message, sizeof(double));
+    message += sizeof(double);
+    if (choiceInfo == NULL) {
+      pheromons[edge] += pheromon / pheromonScale;
+      nReceived[edge]++;
+    } else if (nReceived[edge] > 0) {
+      int i, j;
+      getEdgeCities(edge, nCities, &i, &j);
+      long reverse = getEdgeIndex(j, i, nCities);
+      pheromons[edge] /= 1 + nReceived[edge];
+      pheromons[reverse] = pheromons[edge];
+      nReceived[edge] = 0;
+      updateChoiceInfoEdge(choiceInfo, heuristic, pheromons, edge, nCities, beta);
+      updateChoiceInfoEdge(choiceInfo, heuristic, pheromons, reverse, nCities, beta);
+    }
+  }
+}
+
+/**
+ * Merge the strongest edges received from the other nodes (see
+ * exchangeStrongestEdges) into the pheromons matrix of the node and update
+ * the choice information of the merged edges
+ **/
+void mergeStrongestEdges(StrongestEdges* strongest, double* pheromons, double pheromonScale, double* choiceInfo, Heuristic* heuristic, int nCities, double beta, int prank, int psize) {
+  int i;
+  for (i = 0; i < psize; i++) {
+    if (i != prank) {
+      readStrongestEdges(strongest->messages + strongest->displacements[i], strongest->nReceived, pheromons, pheromonScale, NULL, heuristic, nCities, beta);
+    }
+  }
+  for (i = 0; i < psize; i++) {
+    if (i != prank) {
+      readStrongestEdges(strongest->messages + strongest->displacements[i], strongest->nReceived, pheromons, pheromonScale, choiceInfo, heuristic, nCities, beta);
+    }
+  }
+}
+
+/**
+ * Islands of the island model (see ISLAND_TOPOLOGY)
+ * The mailbox of a rank has one record (see packPathRecord) per neighbour,
+ * exposed to the neighbours in win. A neighbour writes its best path in its
+ * slot with MPI_Put under an exclusive lock, and the rank reads the slots
+ * under an exclusive lock of its own window. An empty slot has a cost of -1.
+ **/
+struct Islands {
+  int nNeighbours;
+  int neighbours[ISLAND_MAX_NEIGHBOURS];
+  // slot of this rank in the mailbox of each neighbour
+  int slots[ISLAND_MAX_NEIGHBOURS];
+  char* mailbox;
+  MPI_Win win;
+  // record sent (packed by the caller) and immigrants received
+  char* record;
+  char* immigrants;
+};
+
+void addIslandNeighbour(int rank, int neighbour, int* neighbours, int* nNeighbours) {
+  int i;
+  if (neighbour == rank) {
+    return;
+  }
+  for (i = 0; i < *nNeighbours; i++) {
+    if (neighbours[i] == neighbour) {
+      return;
+    }
+  }
+  neighbours[(*nNeighbours)++] = neighbour;
+}
+
+/**
+ * Neighbours of a rank in the topology ISLAND_TOPOLOGY
+ * The topologies are symmetric : a rank is a neighbour of its neighbours.
+ * Returns the number of neighbours
+ **/
+int getIslandNeighbours(int rank, int psize, int* neighbours) {
+  int nNeighbours = 0;
+#if ISLAND_TOPOLOGY == ISLAND_RING
+  addIslandNeighbour(rank, (rank + psize - 1) % psize, neighbours, &nNeighbours);
+  addIslandNeighbour(rank, (rank + 1) % psize, neighbours, &nNeighbours);
+#elif ISLAND_TOPOLOGY == ISLAND_TORUS
+  int dims[2] = {0, 0};
+  MPI_Dims_create(psize, 2, dims);
+  int row = rank / dims[1];
+  int column = rank % dims[1];
+  addIslandNeighbour(rank, ((row + dims[0] - 1) % dims[0]) * dims[1] + column, neighbours, &nNeighbours);
+  addIslandNeighbour(rank, ((row + 1) % dims[0]) * dims[1] + column, neighbours, &nNeighbours);
+  addIslandNeighbour(rank, row * dims[1] + (column + dims[1] - 1) % dims[1], neighbours, &nNeighbours);
+  addIslandNeighbour(rank, row * dims[1] + (column + 1) % dims[1], neighbours, &nNeighbours);
+#elif ISLAND_TOPOLOGY == ISLAND_HYPERCUBE
+  // with a number of ranks that is not a power of 2, the missing ranks are skipped
+  long bit;
+  for (bit = 1; bit < psize; bit <<= 1) {
+    if ((rank ^ bit) < psize) {
+      addIslandNeighbour(rank, (int) (rank ^ bit), neighbours, &nNeighbours);
+    }
+  }
+#endif
+  return nNeighbours;
+}
+
+/**
+ * Create the islands and their mailboxes (collective)
+ * Returns 0 if everything is fine
+ **/
+int createIslands(Islands* islands, int nCities) {
+  int prank, psize, i, j;
+  int size = getPathRecordSize(nCities);
+  int neighbours[ISLAND_MAX_NEIGHBOURS];
+  MPI_Comm_rank(MPI_COMM_WORLD, &prank);
+  MPI_Comm_size(MPI_COMM_WORLD, &psize);
+
+  islands->nNeighbours = getIslandNeighbours(prank, psize, islands->neighbours);
+  for (i = 0; i < islands->nNeighbours; i++) {
+    int nNeighbours = getIslandNeighbours(islands->neighbours[i], psize, neighbours);
+    for (j = 0; j < nNeighbours; j++) {
+      if (neighbours[j] == prank) {
+        islands->slots[i] = j;
+      }
+    }
+  }
+
+  // at least one slot, as a window of size 0 may have a NULL base
+  MPI_Aint mailboxSize = (MPI_Aint) std::max(islands->nNeighbours, 1) * size;
+#if MPI_VERSION >= 3
+  if (MPI_Win_allocate(mailboxSize, 1, MPI_INFO_NULL, MPI_COMM_WORLD, &islands->mailbox, &islands->win) != MPI_SUCCESS) {
+    return -1;
+  }
+#else
+  if (MPI_Alloc_mem(mailboxSize, MPI_INFO_NULL, &islands->mailbox) != MPI_SUCCESS) {
+    return -1;
+  }
+  if (MPI_Win_create(islands->mailbox, mailboxSize, 1, MPI_INFO_NULL, MPI_COMM_WORLD, &islands->win) != MPI_SUCCESS) {
+    return -1;
+  }
+#endif
+  // the mailbox is emptied before any neighbour can write into it
+  for (i = 0; i < std::max(islands->nNeighbours, 1); i++) {
+    getRecordHeader(islands->mailbox + (long) i * size)->cost = -1;
+  }
+  if (MPI_Barrier(MPI_COMM_WORLD) != MPI_SUCCESS) {
+    return -1;
+  }
+  islands->record = (char*) malloc(size);
+  islands->immigrants = (char*) malloc(mailboxSize);
+  return 0;
+}
+
+/**
+ * Free the islands (collective)
+ **/
+void freeIslands(Islands* islands) {
+  MPI_Win_free(&islands->win);
+#if MPI_VERSION < 3
+  MPI_Free_mem(islands->mailbox);
+#endif
+  free(islands->record);
+  free(islands->immigrants);
+}
+
+/**
+ * Push the record packed in islands->record into the mailboxes of the
+ * neighbours. It replaces the previous record of this rank if they have not
+ * read it yet.
+ * Returns 0 if everything is fine
+ **/
+int migrate(Islands* islands, int nCities) {
+  int size = getPathRecordSize(nCities);
+  int i;
+  for (i = 0; i < islands->nNeighbours; i++) {
+    int neighbour = islands->neighbours[i];
+    if (MPI_Win_lock(MPI_LOCK_EXCLUSIVE, neighbour, 0, islands->win) != MPI_SUCCESS) {
+      return -1;
+    }
+    if (MPI_Put(islands->record, size, MPI_BYTE, neighbour, (MPI_Aint) islands->slots[i] * size, size, MPI_BYTE, islands->win) != MPI_SUCCESS) {
+      return -1;
+    }
+    if (MPI_Win_unlock(neighbour, islands->win) != MPI_SUCCESS) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Pull the records received in the mailbox since the last call into
+ * islands->immigrants, and empty the mailbox.
+ * Returns the number of immigrants, or -1 on error
+ **/
+int receiveImmigrants(Islands* islands, int nCities) {
+  int size = getPathRecordSize(nCities);
+  int prank, i;
+  int nImmigrants = 0;
+  if (islands->nNeighbours == 0) {
+    return 0;
+  }
+  MPI_Comm_rank(MPI_COMM_WORLD, &prank);
+  if (MPI_Win_lock(MPI_LOCK_EXCLUSIVE, prank, 0, islands->win) != MPI_SUCCESS) {
+    return -1;
+  }
+  for (i = 0; i < islands->nNeighbours; i++) {
+    char* slot = islands->mailbox + (long) i * size;
+    if (getRecordHeader(slot)->cost != -1) {
+      memcpy(islands->immigrants + (long) nImmigrants * size, slot, size);
+      getRecordHeader(slot)->cost = -1;
+      nImmigrants++;
+    }
+  }
+  if (MPI_Win_unlock(prank, islands->win) != MPI_SUCCESS) {
+    return -1;
+  }
+  return nImmigrants;
+}
+
+/**
+ * Print on stderr (rank 0) the scheduling statistics of the threads of all
+ * the ranks (see printSchedulerStats)
+ * Returns 0 if everything is fine
+ **/
+int reportSchedulerStats(AntWorkspace* workspaces) {
+  int prank, psize;
+  double stats[3], totalStats[3];
+  long nSteals;
+  MPI_Comm_rank(MPI_COMM_WORLD, &prank);
+  MPI_Comm_size(MPI_COMM_WORLD, &psize);
+  sumSchedulerStats(workspaces, &stats[0], &stats[1], &nSteals);
+  stats[2] = (double) nSteals;
+  if (MPI_Reduce(stats, totalStats, 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
+    return -1;
+  }
+  if (prank == 0) {
+    printSchedulerStats(psize * getNumberOfThreads(), totalStats[0], totalStats[1], (long) totalStats[2]);
+  }
+  return 0;
+}
+
+#endif
@@ -17,20 +17,19 @@ int main(int argc, char* argv[]) {
 
   printf("NbOfAgents 0\n");
 
-  int i, j, loop_counter, ant_counter, cities_counter;
-  int *map = NULL;
+  int i, j, loop_counter;
+  DistanceMatrix map;
   double *pheromons;
-  // bestPath is a vector representing all cities in order.
-  // If the value is 0, the city was not visited
-  // else, the city is visited at step i
+  // bestPath is a vector representing all cities in visit order.
   int *bestPath;
-  int *currentPath;
   long bestCost = INFTY;
 
   // To compare implementations, we need to have a fixed randomization.
   long nRandomNumbers = 0;
   long* randomNumbers;
   long random_counter = 0;
+  // seed of the random numbers generator (COUNTER_RNG)
+  uint64_t seed = 0;
 
   char* mapFile = argv[1];
   char* randomFile = argv[2];
@@ -52,78 +51,64 @@ int main(int argc, char* argv[]) {
   /*****************************/
 
   /********* LOAD MAP *********/
-  // Load the map and the number of cities
-  std::ifstream in;
-  in.open(mapFile);
-
-  if (!in.is_open()) {
-    printf("Cannot open file.\n");
+  // Load the map (TSPLIB or generate_map format) and the number of cities
+  if (LoadMap(mapFile, &map, &nCities)) {
     printf("The filepath %s is incorrect\n", mapFile);
     return -1;
   }
-  char out[12];
-  in >> out;
-
-  // Define number of cities
-  nCities = atoi(out);
 
   printf("Cities %d\n", nCities);
 
-  // Allocation of map
-  map = (int*) malloc(nCities*nCities*sizeof(int));
-
-  in.close();
-
-  // Load the map inside map variable
-  if (LoadCities(mapFile, map)) {
-    printf("The filepath %s is incorrect\n", mapFile);
-    return -1;
-  }
-
   /*****************************/
 
   /**** LOAD RANDOM NUMBERS ****/
-  // Read random number file
-  in.open(randomFile);
-
-  if (!in.is_open()) {
-    printf("Cannot open file.\n");
+#ifdef COUNTER_RNG
+  // The random numbers are generated, the random file argument is the seed
+  seed = strtoull(randomFile, NULL, 10);
+  randomNumbers = NULL;
+#else
+  // Read random number file (generate_random_numbers format or binary)
+  if (LoadRandomNumbers(randomFile, &randomNumbers, &nRandomNumbers)) {
     printf("The filepath %s is incorrect\n", randomFile);
     return -1;
   }
-
-  in >> out;
-
-  // Define number of random numbers
-  nRandomNumbers = atol(out);
-
-  // Allocation of random numbers vector
-  randomNumbers = (long*) malloc(nRandomNumbers*sizeof(long));
-
-  i = 0;
-  while (!in.eof()) {
-    in >> out;
-    randomNumbers[i] = atol(out);
-    i++;
-  }
+#endif
 
   /*****************************/
 
   /*** VARIABLES ALLOCATION ***/
 
-  pheromons = (double*) malloc(nCities*nCities*sizeof(double));
+  pheromons = (double*) malloc(getMatrixSize(nCities)*sizeof(double));
   bestPath = (int*) malloc(nCities*sizeof(int));
-  currentPath = (int*) malloc(nCities*sizeof(int));
 
   // Initialisation of pheromons and other vectors
   for (i = 0; i < nCities; i++) {
-    currentPath[i] = -1;
     bestPath[i] = -1;
   }
-  for (j = 0; j < nCities*nCities; j++) {
+  for (j = 0; j < getMatrixSize(nCities); j++) {
     pheromons[j] = 0.1;
   }
 
+  // Global scale of the pheromons matrix (see evaporatePheromons)
+  double pheromonScale = 1.0;
+
+  // Candidate lists of nearest neighbours (NULL if not used)
+  int nNeighbours = std::min(NN_LIST_SIZE, nCities - 1);
+  int* nearestNeighbours = NULL;
+  if (nNeighbours > 0) {
+    nearestNeighbours = computeNearestNeighbours(&map, nCities, nNeighbours);
+  }
+
+  // Choice information used to build paths (heuristic part is computed once)
+  Heuristic heuristic;
+  computeHeuristic(&heuristic, &map, nCities, alpha);
+  cacheNeighboursHeuristic(&heuristic, nearestNeighbours, nNeighbours);
+  double* choiceInfo = (double*) malloc(getMatrixSize(nCities)*sizeof(double));
+  updateChoiceInfo(choiceInfo, &heuristic, pheromons, nCities, beta);
+
+  // Scratch buffers of the ants (one per thread)
+  AntWorkspace* workspaces = allocateWorkspaces(nCities);
+
   loop_counter = 0;
   long antsBestCost = INFTY;
 
@@ -134,43 +119,14 @@ int main(int argc, char* argv[]) {
 
     // printf("Loop nr. : %d, terminationCondition : %ld,, bestCost : %ld\n", loop_counter, terminationCondition,bestCost);
 
-    // Loop over each ant
-    for (ant_counter = 0; ant_counter < nAnts; ant_counter++) {
-      // init currentPath 
-      // -1 means not visited
-      for (i = 0; i < nCities; i++) {
-        currentPath[i] = -1;
-      }
-
-      // select a random start city for an ant
-      long rand = randomNumbers[random_counter];
-      int currentCity = rand % nCities;
-      random_counter = (random_counter + 1) % nRandomNumbers;
-      // currentPath will contain the order of visited cities
-      currentPath[currentCity] = 0;
-      for (cities_counter = 1; cities_counter < nCities; cities_counter++) {
-        // Find next city
-        rand = randomNumbers[random_counter];
-        currentCity = computeNextCity(currentCity, currentPath, map, nCities, pheromons, alpha, beta, rand);
-        random_counter = (random_counter + 1) % nRandomNumbers;
-
-
-        if (currentCity == -1) {
-          printf("There is an error choosing the next city in iteration %d fot ant %d\n", loop_counter, ant_counter);
-          return -1;
-        }
-
-        // add next city to plan
-        currentPath[currentCity] = cities_counter;
-      }
-
-      // update bestCost and bestPath
-      long oldCost = bestCost;
-      bestCost = computeCost(bestCost, bestPath, currentPath, map, nCities);
-
-      if (oldCost > bestCost) {
-        copyVectorInt(currentPath, bestPath, nCities);
-      }
+    // Build the paths of the ants (in parallel with OpenMP)
+    // and keep the best one
+    bestCost = buildAntsPaths(&map, choiceInfo, nCities, nAnts, randomNumbers, nRandomNumbers, random_counter, seed, loop_counter, 0, nearestNeighbours, nNeighbours, workspaces, bestPath, bestCost);
+    random_counter = advanceRandomCounter(random_counter, (long) nAnts * nCities, nRandomNumbers);
+
+    if (bestCost == -1) {
+      printf("There is an error choosing the next city in iteration %d\n", loop_counter);
+      return -1;
     }
 
     if (bestCost < antsBestCost) {
@@ -180,12 +136,13 @@ int main(int argc, char* argv[]) {
       terminationCondition++;
     }
 
-    // Pheromon evaporation
-    for (j = 0; j < nCities*nCities; j++) {
-      pheromons[j] *= evaporationCoeff;
+    // Pheromon evaporation (only the scale of the matrix changes)
+    if (evaporatePheromons(pheromons, &pheromonScale, evaporationCoeff, nCities, beta)) {
+      updateChoiceInfo(choiceInfo, &heuristic, pheromons, nCities, beta);
     }
-    // Update pheromons
-    updatePheromons(pheromons, bestPath, bestCost, nCities);
+    // Update pheromons and the choice information of the edges of the best path
+    updatePheromons(pheromons, pheromonScale, bestPath, bestCost, nCities);
+    updateChoiceInfoPath(choiceInfo, &heuristic, pheromons, bestPath, nCities, beta);
 
     loop_counter++;
   }
@@ -198,11 +155,23 @@ int main(int argc, char* argv[]) {
   printf("Total time %f\n", (end-start));
   /*****************************/
 
+#ifdef _OPENMP
+  // Time the threads waited for each other at the end of the iterations
+  double busyTime, waitTime;
+  long nSteals;
+  sumSchedulerStats(workspaces, &busyTime, &waitTime, &nSteals);
+  printSchedulerStats(getNumberOfThreads(), busyTime, waitTime, nSteals);
+#endif
+
   // deallocate the pointers
-  free(map);
+  free(randomNumbers);
+  freeDistances(&map);
   free(pheromons);
   free(bestPath);
-  free(currentPath);
+  freeHeuristic(&heuristic);
+  free(choiceInfo);
+  free(nearestNeighbours);
+  freeWorkspaces(workspaces);
 
   return 0;
 }